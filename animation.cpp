@@ -2,11 +2,10 @@
 //  COSC422: Advanced Computer Graphics;  University of Canterbury (2019)
 //  ========================================================================
 
-// TODO: Cache vertex/normals - speedup
-// TODO: SceneMin/Max per frame
 // TODO: Track movement and move floor plane accordingly
 // TODO: Remap properly
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 
 #include <IL/il.h>
@@ -17,686 +16,750 @@
 #include <assimp/types.h>
 
 #include "assimp_extras.h"
-
+#include "character.h"
+#include "compressed_clip.h"
+#include "headless.h"
+#include "keyframes.h"
+#include "pose_cache.h"
+#include "retargeting.h"
+#include "scenes.h"
+#include "skinning.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "shader.h"
+
 //----------Globals----------------------------
-const aiScene* scene = NULL;
-const aiScene* animationScene = NULL;
 int oldTimeSinceStart;
 float angle = 135;
 float distance = 5;
-std::unordered_map<int, int> texIdMap;
 GLuint floorTexture;
 bool keyState[256] = {};
 bool specialKeyState[GLUT_KEY_INSERT + 1] = {};
 
 //------------Modify the following as needed----------------------
 float materialCol[4] = {0.9, 0.9, 0.9, 1}; //Default material colour (not used if model's colour is available)
-float shadowColour[4] = {0, 0, 0, 1}; //Default material colour (not used if model's colour is available)
+float shadowColour[4] = {0, 0, 0, 1}; //Colour of the floor where the character's shadow falls on it
 float lightPosn[4] = {2, 10, 5, 0}; //Default light's position
 bool twoSidedLight = false; //Change to 'true' to enable two-sided lighting
-
-int tDuration; //Animation duration in ticks.
-int currTick = 0; //current tick
+int shadowMapSize = 2048; //Resolution of the shadow map, shadow cost scales with this rather than the model
+bool bakeAnimation = true; //Bake every tick at load, or evaluate poses when first shown
+size_t poseCacheSize = 16 * 1024 * 1024; //Memory cap for poses evaluated on demand
+int crowdSize = 256; //Characters drawn in crowd mode, toggled with 'm'
+bool parallelBake = true; //Bake on the thread pool, or one tick after another on the loading thread
+bool compressAnimation = false; //Sample quantized, keyframe reduced copies of the channels instead of the raw keys
+ClipTolerance clipTolerance{}; //Largest error keyframe reduction may introduce
+
+double currTime = 0; //current time in ticks, usually between two ticks
 int timeStep = 50; //Animation time step = 50 m.sec
+bool uncappedFrameRate = true; //Redraw as fast as the display allows instead of every timeStep
+bool directSampling = false; //Sample the keys at the current time instead of blending the two nearest poses
 
 bool dwarfSpecial = false;
 int currentSceneId = 0;
-const int maxSceneId = 3;
+const int maxSceneId = sceneCount;
 
-#if !defined(_MSC_VER)
-#define __debugbreak() asm("int3")
-#endif
+ThreadPool threadPool{std::max(2u, std::thread::hardware_concurrency()) - 1};
+SkinningPath skinningPath = SkinningPath::Scalar;
 
-struct BoneInfo
+// Must match MAX_BONES in data/skinning.vert
+const int maxGpuBones = 128;
+// Number of regions in each streaming vertex buffer, so the CPU never writes a region the GPU may still be reading
+const int streamRegions = 3;
+
+// Attributes written every frame by the CPU skinning path
+struct StreamVertex
 {
-	aiMatrix4x4 offsetMatrix;
-	std::vector<aiMatrix4x4> matrix;
-	std::vector<aiMatrix4x4> invmatrix;
-	int parentIndex;
+	float position[3];
+	float normal[3];
 };
 
-struct ScenePositions
+struct MeshBuffers
 {
-	aiVector3D min;
-	aiVector3D max;
-	aiVector3D center;
-	float scale;
+	GLuint indexBuffer;
+	// Indices are grouped as points, then lines, then triangles
+	GLsizei indexCounts[3];
+
+	GLuint gpuVertexArray;
+	GLuint gpuVertexBuffer;
+
+	GLuint staticBuffer;
+	GLuint streamBuffer;
+	GLuint streamVertexArrays[streamRegions];
+	StreamVertex* streamMapping;
 };
 
-ScenePositions positions{};
-std::vector<BoneInfo> bones{};
-std::vector<std::vector<aiMatrix4x4>> animationMatrices{};
-std::vector<std::vector<std::vector<std::pair<float, int>>>> vertexWeights{};
-std::vector<aiVector3D> movementDeltas = std::vector<aiVector3D>(1000, aiVector3D());
-std::unordered_map<std::string, std::string> dwarfRemapping
-{
-	{"lhip", "rThigh"},
-	{"rhip", "lThigh"},
-	{"lknee", "rShin"},
-	{"rknee", "lShin"},
-	{"lankle", "rFoot"},
-	{"rankle", "lFoot"},
-	// {"ltoe", "rFoot"},
-	// {"rtoe", "lFoot"},
+// GL objects of one character, created on the GL thread a piece per frame once the character has loaded
+struct CharacterBuffers
+{
+	std::vector<MeshBuffers> meshes;
+	// One per decoded texture of the character
+	std::vector<GLuint> textures;
+	bool gpuSkinningSupported;
 };
 
-//-------------Loads texture files using DevIL library-------------------------------
-void loadGLTextures(const std::string& path, const aiScene* scene)
+// The character on screen, and the one being loaded to replace it
+std::unique_ptr<Character> character{};
+CharacterBuffers characterBuffers{};
+std::unique_ptr<Character> pendingCharacter{};
+CharacterBuffers pendingBuffers{};
+size_t pendingStep = 0;
+
+// Handed over from the loading thread
+std::mutex loadMutex{};
+std::unique_ptr<Character> loadedCharacter{};
+std::atomic<bool> loading{false};
+std::atomic<float> loadProgress{0};
+
+bool gpuSkinning = false;
+std::unique_ptr<Shader> skinningShader{};
+// Lights the CPU skinned vertices and the floor like data/skinning.vert lights the GPU skinned ones
+std::unique_ptr<Shader> streamShader{};
+GLuint paletteBuffer = 0;
+GLuint textureUploadBuffer = 0;
+int streamRegion = 0;
+GLsync streamFences[streamRegions] = {};
+
+// Crowd mode draws every character with one instanced draw per mesh, sharing the baked clip through a texture buffer
+struct CrowdInstance
 {
-	if (scene->HasTextures())
-	{
-		std::cout << "Support for meshes with embedded textures is not implemented" << std::endl;
-		return;
-	}
+	float transform[16];
+	float timeOffset;
+};
 
-	texIdMap.clear();
+bool crowdMode = false;
+std::unique_ptr<Shader> crowdShader{};
+GLuint crowdPaletteBuffer = 0;
+GLuint crowdPaletteTexture = 0;
+GLuint crowdInstanceBuffer = 0;
+// Everywhere any character can reach over the whole clip, in model units, as each plays from its own offset
+BoundingBox crowdBounds{};
+
+// Depth from the light, rendered each frame from the same skinned vertices as the lit pass
+GLuint shadowFramebuffer = 0;
+GLuint shadowMapTexture = 0;
+aiMatrix4x4 lightView{};
+aiMatrix4x4 lightProjection{};
+// Inverse of the camera's view, so eye space positions can be looked up in the shadow map
+aiMatrix4x4 eyeToWorld{};
 
-	/* scan scene's materials for textures */
-	/* Simplified version: Retrieves only the first texture with index 0 if present*/
-	for (unsigned int m = 0; m < scene->mNumMaterials; ++m)
+// ------A recursive function to traverse scene graph and render each mesh----------
+void render(const Character& sc, const CharacterBuffers& buffers, GLuint program, bool depthOnly)
+{
+	for (auto j = 0u; j < sc.meshes.size(); j++)
 	{
-		aiString fileName; // filename
+		const auto& mesh = sc.meshes[j];
+		const auto texture = sc.materialTextures.at(mesh.materialIndex);
+		const auto textured = mesh.texCoords && !depthOnly && texture >= 0;
+		const auto vertexColoured = !depthOnly && !mesh.texCoords && mesh.colours;
+		
+		if (textured)
+		{
+			glEnable(GL_TEXTURE_2D);
+		}
+		else
+		{
+			glDisable(GL_TEXTURE_2D);
+		}
+
+		const auto& mtl = sc.materials.at(mesh.materialIndex); //Get material attached to the mesh
+		if (mtl.hasDiffuse)
+		{
+			//Get material colour from model
+			glColor4f(mtl.diffuse.r, mtl.diffuse.g, mtl.diffuse.b, 1.0);
+		}
+		else
+		{
+			glColor4fv(materialCol); //Default material colour
+		}
+		
+		if (textured)
+		{
+			glBindTexture(GL_TEXTURE_2D, buffers.textures.at(texture));
+		}
 
-		if (scene->mMaterials[m]->GetTexture(aiTextureType_DIFFUSE, 0, &fileName) == AI_SUCCESS)
+		const auto& meshBuffers = buffers.meshes.at(j);
+		glUniform1i(glGetUniformLocation(program, "useTexture"), textured);
+		glUniform1i(glGetUniformLocation(program, "useVertexColour"), vertexColoured);
+		if (gpuSkinning || crowdMode)
+		{
+			glBindVertexArray(meshBuffers.gpuVertexArray);
+		}
+		else
 		{
-			ILuint imageId;
-			GLuint texId;
-			ilGenImages(1, &imageId);
-			glGenTextures(1, &texId);
-			texIdMap[m] = texId; //store tex ID against material id in a hash map
-			ilBindImage(imageId); /* Binding of DevIL image name */
-			ilEnable(IL_ORIGIN_SET);
-			ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
-
-			std::string realFileName = fileName.data;
-
-			auto lastIndex = realFileName.rfind('/');
-			auto realLastIndex = -1;
-			if (lastIndex != std::string::npos)
+			glBindVertexArray(meshBuffers.streamVertexArrays[streamRegion]);
+			if (textured)
 			{
-				realLastIndex = lastIndex;
+				glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 			}
-
-			lastIndex = realFileName.rfind('\\');
-			if (lastIndex != std::string::npos)
+			else
 			{
-				realLastIndex = std::max(static_cast<int>(lastIndex), realLastIndex);
+				glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 			}
 
-			if (realLastIndex >= 0)
+			if (vertexColoured)
 			{
-				realFileName = realFileName.substr(realLastIndex + 1);
+				glEnableClientState(GL_COLOR_ARRAY);
 			}
+			else
+			{
+				glDisableClientState(GL_COLOR_ARRAY);
+			}
+		}
 
-			realFileName = path + realFileName;
-
-			if (ilLoadImage(realFileName.c_str())) //if success
+		//Draw the points, lines and triangles of each mesh
+		const GLenum modes[] = {GL_POINTS, GL_LINES, GL_TRIANGLES};
+		auto offset = 0;
+		for (auto k = 0; k < 3; k++)
+		{
+			if (meshBuffers.indexCounts[k] > 0 && crowdMode)
 			{
-				/* Convert image to RGBA */
-				ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
-
-				/* Create and load textures to OpenGL */
-				glBindTexture(GL_TEXTURE_2D, texId);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ilGetInteger(IL_IMAGE_WIDTH),
-				             ilGetInteger(IL_IMAGE_HEIGHT), 0, GL_RGBA, GL_UNSIGNED_BYTE,
-				             ilGetData());
-				// glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-				std::cout << "Texture:" << realFileName << " successfully loaded." << std::endl;
-				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-				glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-				glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-				glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+				glDrawElementsInstanced(modes[k], meshBuffers.indexCounts[k], GL_UNSIGNED_INT, reinterpret_cast<void*>(offset * sizeof(GLuint)), crowdSize);
 			}
-			else
+			else if (meshBuffers.indexCounts[k] > 0)
 			{
-				std::cout << "Couldn't load Image: " << realFileName << std::endl;
+				glDrawElements(modes[k], meshBuffers.indexCounts[k], GL_UNSIGNED_INT, reinterpret_cast<void*>(offset * sizeof(GLuint)));
 			}
+			offset += meshBuffers.indexCounts[k];
 		}
-	} //loop for material
+	}
+
+	glBindVertexArray(0);
 }
 
-//-------Loads model data from file and creates a scene object----------
-bool loadModel(const std::string& fileName, const std::string& animationFileName)
+// Copies the skinned vertices into the next region of every streaming buffer
+void StreamSkinnedMeshes(const Character& sc, CharacterBuffers& buffers)
 {
-	if (scene)
-	{
-		aiReleaseImport(scene);
-	}
-	
-	if (animationScene)
-	{
-		aiReleaseImport(animationScene);
-	}
-
-	auto flags = aiProcessPreset_TargetRealtime_MaxQuality;
-	if (fileName.compare(fileName.size() - 4, 4, ".bvh") == 0)
-	{
-		flags |= aiProcess_Debone;
-	}
-	scene = aiImportFile(fileName.c_str(), flags);
-	if (scene == nullptr)
+	streamRegion = (streamRegion + 1) % streamRegions;
+	if (streamFences[streamRegion])
 	{
-		throw std::exception();
+		glClientWaitSync(streamFences[streamRegion], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(streamFences[streamRegion]);
+		streamFences[streamRegion] = nullptr;
 	}
 
-	if (!animationFileName.empty())
+	std::vector<StreamVertex> vertices{};
+	for (auto i = 0u; i < sc.skinnedMeshes.size(); i++)
 	{
-		animationScene = aiImportFile(animationFileName.c_str(), aiProcessPreset_TargetRealtime_MaxQuality);
-		if (animationScene == nullptr)
-		{
-			throw std::exception();
-		}
-	}
-	else
-	{
-		animationScene = nullptr;
-	}
+		const auto& input = sc.skinnedMeshes[i].input;
+		const auto& skinned = sc.skinnedMeshes[i].output;
+		auto& meshBuffers = buffers.meshes.at(i);
 
-	loadGLTextures(fileName.substr(0, fileName.rfind('/') + 1), scene);
-
-	if (animationScene && !dwarfSpecial)
-	{
-		if (animationScene->mAnimations)
+		auto target = meshBuffers.streamMapping;
+		if (!target)
 		{
-			tDuration = animationScene->mAnimations[0]->mDuration;
+			vertices.resize(input.vertexCount);
+			target = vertices.data();
 		}
 		else
 		{
-			tDuration = 0;
+			target += streamRegion * input.vertexCount;
 		}
-	}
-	else
-	{
-		if (scene->mAnimations)
+
+		for (auto v = 0; v < input.vertexCount; v++)
 		{
-			tDuration = scene->mAnimations[0]->mDuration;
+			target[v].position[0] = skinned.positionX[v];
+			target[v].position[1] = skinned.positionY[v];
+			target[v].position[2] = skinned.positionZ[v];
+			if (input.hasNormals)
+			{
+				target[v].normal[0] = skinned.normalX[v];
+				target[v].normal[1] = skinned.normalY[v];
+				target[v].normal[2] = skinned.normalZ[v];
+			}
 		}
-		else
+
+		if (!meshBuffers.streamMapping)
 		{
-			tDuration = 0;
+			const auto size = input.vertexCount * sizeof(StreamVertex);
+			glBindBuffer(GL_ARRAY_BUFFER, meshBuffers.streamBuffer);
+			glBufferSubData(GL_ARRAY_BUFFER, streamRegion * size, size, vertices.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
 		}
 	}
-	return true;
 }
 
-aiMatrix4x4 FindMatrix(std::unordered_map<std::string, int>& boneMapping, aiNode* node, int tick)
+// Marks the current streaming region as in use until the GPU has finished the frame
+void FenceStreamRegion()
 {
-	const auto mapping = boneMapping.find(node->mName.C_Str());
-	aiMatrix4x4 transformation;
-	if (mapping == boneMapping.end())
-	{
-		transformation = node->mTransformation;
-	}
-	else
+	if (streamFences[streamRegion])
 	{
-		transformation = animationMatrices.at(mapping->second).at(tick);
+		glDeleteSync(streamFences[streamRegion]);
 	}
-	
-	if (node->mParent == NULL)
+	streamFences[streamRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Skins every mesh on the CPU and streams the result, unless the meshes already hold this time
+void SkinMeshes(Character& sc, CharacterBuffers& buffers, double time)
+{
+	if (sc.skin(time, skinningPath, directSampling))
 	{
-		return transformation;
+		StreamSkinnedMeshes(sc, buffers);
 	}
+}
+
+// Sends the palette for the given time to the GPU, the only per frame work of GPU skinning
+void UploadPalette(Character& sc, double time)
+{
+	sc.updatePalette(time, directSampling);
 
-	return FindMatrix(boneMapping, node->mParent, tick) * transformation;
+	const auto size = sc.bones.size() * PALETTE_STRIDE * sizeof(float);
+	glBindBuffer(GL_UNIFORM_BUFFER, paletteBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, sc.palette.position.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-// ------A recursive function to traverse scene graph and render each mesh----------
-void render(const aiScene* sc, bool shadow)
+void ReleaseCharacterBuffers(CharacterBuffers& buffers)
 {
-	for (auto j = 0u; j < sc->mNumMeshes; j++)
+	for (auto& meshBuffers : buffers.meshes)
 	{
-		const auto& meshWeights = vertexWeights.at(j);
-		auto mesh = scene->mMeshes[j];
-		
-		if (mesh->HasTextureCoords(0) && !shadow)
-		{
-			glEnable(GL_TEXTURE_2D);
-		}
-		else
+		if (meshBuffers.streamMapping)
 		{
-			glDisable(GL_TEXTURE_2D);
+			glBindBuffer(GL_ARRAY_BUFFER, meshBuffers.streamBuffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
 		}
+		glDeleteBuffers(1, &meshBuffers.indexBuffer);
+		glDeleteBuffers(1, &meshBuffers.gpuVertexBuffer);
+		glDeleteBuffers(1, &meshBuffers.staticBuffer);
+		glDeleteBuffers(1, &meshBuffers.streamBuffer);
+		glDeleteVertexArrays(1, &meshBuffers.gpuVertexArray);
+		glDeleteVertexArrays(streamRegions, meshBuffers.streamVertexArrays);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	buffers.meshes.clear();
 
-		aiColor4D diffuse;
-		int materialIndex = mesh->mMaterialIndex; //Get material index attached to the mesh
-		auto mtl = sc->mMaterials[materialIndex];
-		if (shadow)
-		{
-			glColor4fv(shadowColour); //User-defined colour
-		}
-		else if (AI_SUCCESS == aiGetMaterialColor(mtl, AI_MATKEY_COLOR_DIFFUSE, &diffuse))
-		{
-			//Get material colour from model
-			glColor4f(diffuse.r, diffuse.g, diffuse.b, 1.0);
-		}
-		else
-		{
-			glColor4fv(materialCol); //Default material colour
-		}
-		
-		if (mesh->HasTextureCoords(0) && !shadow)
-		{
-			glBindTexture(GL_TEXTURE_2D, texIdMap[materialIndex]);
-		}
+	glDeleteTextures(buffers.textures.size(), buffers.textures.data());
+	buffers.textures.clear();
+}
 
-		//Get the polygons from each mesh and draw them
-		for (auto k = 0u; k < mesh->mNumFaces; k++)
-		{
-			const auto face = &mesh->mFaces[k];
-			GLenum face_mode;
-			
-			switch (face->mNumIndices)
-			{
-			case 1: face_mode = GL_POINTS;
-				break;
-			case 2: face_mode = GL_LINES;
-				break;
-			case 3: face_mode = GL_TRIANGLES;
-				break;
-			default: face_mode = GL_POLYGON;
-				break;
-			}
-			
-			glBegin(face_mode);
-			
-			for (auto i = 0u; i < face->mNumIndices; i++)
-			{
-				const int vertexIndex = face->mIndices[i];
-				const auto& vertexWeight = meshWeights.at(vertexIndex);
-				
-				if (shadow)
-				{
-				}
-				else if (mesh->HasTextureCoords(0))
-				{
-					glTexCoord2f(mesh->mTextureCoords[0][vertexIndex].x, mesh->mTextureCoords[0][vertexIndex].y);
-				}
-				else if (mesh->HasVertexColors(0))
-				{
-					glColor4fv(reinterpret_cast<GLfloat*>(&mesh->mColors[0][vertexIndex]));
-				}
-				
-				if (mesh->HasNormals())
-				{
-					aiVector3D normal = aiVector3D();
-					for (auto weight : vertexWeight)
-					{
-						normal += bones.at(weight.second).invmatrix.at(currTick) * mesh->mNormals[vertexIndex] * weight.first;
-					}
-					glNormal3fv(&normal.x);
-				}
-
-				aiVector3D vertex = aiVector3D();
-				for (auto weight : vertexWeight)
-				{
-					vertex += bones.at(weight.second).matrix.at(currTick) * mesh->mVertices[vertexIndex] * weight.first;
-				}
-				glVertex3fv(&vertex.x);
-			}
-			
-			glEnd();
-		}
-	}
+// Index buffer shared by both skinning paths, points first, then lines, then triangles
+void BuildIndexBuffer(const MeshData& mesh, MeshBuffers& buffers)
+{
+	std::copy(mesh.indexCounts, mesh.indexCounts + 3, buffers.indexCounts);
+	const auto indexCount = mesh.indexCounts[0] + mesh.indexCounts[1] + mesh.indexCounts[2];
+
+	glGenBuffers(1, &buffers.indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), mesh.indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// Static bind pose buffer with the packed bone influences of every vertex, skinned by data/skinning.vert
+void BuildGpuVertexBuffer(const MeshData& mesh, MeshBuffers& buffers)
+{
+	glGenVertexArrays(1, &buffers.gpuVertexArray);
+	glGenBuffers(1, &buffers.gpuVertexBuffer);
+	glBindVertexArray(buffers.gpuVertexArray);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.gpuVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(GpuSkinnedVertex), mesh.gpuVertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GpuSkinnedVertex), reinterpret_cast<void*>(offsetof(GpuSkinnedVertex, position)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GpuSkinnedVertex), reinterpret_cast<void*>(offsetof(GpuSkinnedVertex, normal)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GpuSkinnedVertex), reinterpret_cast<void*>(offsetof(GpuSkinnedVertex, texCoord)));
+	glEnableVertexAttribArray(3);
+	glVertexAttribIPointer(3, 4, GL_UNSIGNED_SHORT, sizeof(GpuSkinnedVertex), reinterpret_cast<void*>(offsetof(GpuSkinnedVertex, boneIndices)));
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(GpuSkinnedVertex), reinterpret_cast<void*>(offsetof(GpuSkinnedVertex, boneWeights)));
+	glEnableVertexAttribArray(5);
+	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(GpuSkinnedVertex), reinterpret_cast<void*>(offsetof(GpuSkinnedVertex, colour)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-aiMatrix4x4 GetKeyframe(aiNodeAnim* pAnim, float j)
+// Static texture coordinates and colours plus a streaming buffer the CPU skinned vertices are written into every frame
+// The streaming buffer is persistently mapped when the driver supports it
+void BuildStreamVertexBuffers(const MeshData& mesh, MeshBuffers& buffers)
 {
-	if (dwarfSpecial && pAnim->mNodeName.C_Str() == std::string{"middle"})
+	glGenBuffers(1, &buffers.staticBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.staticBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(StaticVertex), mesh.staticVertices, GL_STATIC_DRAW);
+
+	const auto regionSize = mesh.vertexCount * sizeof(StreamVertex);
+	glGenBuffers(1, &buffers.streamBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.streamBuffer);
+	buffers.streamMapping = nullptr;
+	if (GLEW_ARB_buffer_storage && regionSize > 0)
 	{
-		j = 0;
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, streamRegions * regionSize, nullptr, flags);
+		buffers.streamMapping = static_cast<StreamVertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, streamRegions * regionSize, flags));
 	}
-	
-	aiVector3D position;
-	auto foundPosition = false;
-	if (pAnim->mNumPositionKeys == 1)
+	else
 	{
-		position = pAnim->mPositionKeys[0].mValue;
-		foundPosition = true;
+		glBufferData(GL_ARRAY_BUFFER, streamRegions * regionSize, nullptr, GL_STREAM_DRAW);
 	}
-	else
+
+	glGenVertexArrays(streamRegions, buffers.streamVertexArrays);
+	for (auto region = 0; region < streamRegions; region++)
 	{
-		for (auto i = 0u; i < pAnim->mNumPositionKeys; i++)
-		{
-			if (pAnim->mPositionKeys[i].mTime == j)
-			{
-				position = pAnim->mPositionKeys[i].mValue;
-				foundPosition = true;
-				break;
-			}
+		glBindVertexArray(buffers.streamVertexArrays[region]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
 
-			if (i > 0 && pAnim->mPositionKeys[i - 1].mTime < j && pAnim->mPositionKeys[i].mTime >= j)
-			{
-				const auto previous = pAnim->mPositionKeys[i - 1].mValue;
-				const auto current = pAnim->mPositionKeys[i].mValue;
-				const auto delta = (j - pAnim->mPositionKeys[i - 1].mTime) / (pAnim->mPositionKeys[i].mTime - pAnim->mPositionKeys[i - 1].mTime);
-				position = (current - previous).SymMul(aiVector3D(delta)) + previous;
-				foundPosition = true;
-				break;
-			}
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.streamBuffer);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(StreamVertex), reinterpret_cast<void*>(region * regionSize + offsetof(StreamVertex, position)));
+		if (mesh.normals)
+		{
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glNormalPointer(GL_FLOAT, sizeof(StreamVertex), reinterpret_cast<void*>(region * regionSize + offsetof(StreamVertex, normal)));
 		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.staticBuffer);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(StaticVertex), reinterpret_cast<void*>(offsetof(StaticVertex, texCoord)));
+		glColorPointer(4, GL_FLOAT, sizeof(StaticVertex), reinterpret_cast<void*>(offsetof(StaticVertex, colour)));
 	}
 
-	if (!foundPosition)
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Uploads through a pixel buffer object, so the driver copies the pixels to the texture without stalling the frame
+void UploadTexture(const DecodedTexture& decoded, CharacterBuffers& buffers)
+{
+	const auto size = decoded.pixels.size();
+	if (!textureUploadBuffer)
+	{
+		glGenBuffers(1, &textureUploadBuffer);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, textureUploadBuffer);
+	// Orphans the previous upload's storage rather than waiting for the GPU to finish reading it
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	const auto mapping = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapping)
 	{
-		__debugbreak();
-		throw std::exception{};
+		std::copy(decoded.pixels.begin(), decoded.pixels.end(), static_cast<unsigned char*>(mapping));
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 	}
 
-	aiQuaternion rotation;
-	auto foundRotation = false;
-	if (pAnim->mNumRotationKeys == 1)
+	GLuint texId;
+	glGenTextures(1, &texId);
+	buffers.textures.push_back(texId);
+
+	glBindTexture(GL_TEXTURE_2D, texId);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (mapping)
 	{
-		rotation = pAnim->mRotationKeys[0].mValue;
-		foundRotation = true;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, decoded.width, decoded.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
 	else
 	{
-		for (auto i = 0u; i < pAnim->mNumRotationKeys; i++)
-		{
-			if (pAnim->mRotationKeys[i].mTime == j)
-			{
-				rotation = pAnim->mRotationKeys[i].mValue;
-				foundRotation = true;
-				break;
-			}
-
-			if (i > 0 && pAnim->mRotationKeys[i - 1].mTime < j && pAnim->mRotationKeys[i].mTime >= j)
-			{
-				const auto previous = pAnim->mRotationKeys[i - 1].mValue;
-				const auto current = pAnim->mRotationKeys[i].mValue;
-				const auto delta = (j - pAnim->mRotationKeys[i - 1].mTime) / (pAnim->mRotationKeys[i].mTime - pAnim->mRotationKeys[i - 1].mTime);
-				aiQuaternion::Interpolate(rotation, previous, current, delta);
-				foundRotation = true;
-				break;
-			}
-		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, decoded.width, decoded.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.pixels.data());
 	}
+	std::cout << "Texture:" << decoded.fileName << " successfully loaded." << std::endl;
+}
+
+// Creates the retained buffers of one mesh for both skinning paths
+void BuildMeshBuffers(const Character& sc, unsigned int meshIndex, CharacterBuffers& buffers)
+{
+	const auto& mesh = sc.meshes.at(meshIndex);
+	buffers.meshes.resize(sc.meshes.size());
+	auto& meshBuffers = buffers.meshes.at(meshIndex);
+	meshBuffers = {};
 
-	if (!foundRotation)
+	BuildIndexBuffer(mesh, meshBuffers);
+	if (buffers.gpuSkinningSupported)
 	{
-		__debugbreak();
-		throw std::exception{};
+		BuildGpuVertexBuffer(mesh, meshBuffers);
 	}
+	BuildStreamVertexBuffers(mesh, meshBuffers);
+}
 
-	// TODO: Scale?
-
-	aiMatrix4x4 positionMatrix;
-	aiMatrix4x4::Translation(position, positionMatrix);
-
-	const auto rotationMatrix = aiMatrix4x4(rotation.GetMatrix());
-
-	return positionMatrix * rotationMatrix;
+void ReleaseCrowd()
+{
+	glDeleteTextures(1, &crowdPaletteTexture);
+	glDeleteBuffers(1, &crowdPaletteBuffer);
+	glDeleteBuffers(1, &crowdInstanceBuffer);
+	crowdPaletteTexture = 0;
+	crowdPaletteBuffer = 0;
+	crowdInstanceBuffer = 0;
 }
 
-void FindBones(const aiNode* node, std::unordered_map<std::string, int>& boneMapping)
+// Uploads every tick of the clip as one texture buffer and lays the characters out on a grid, each with its own
+// time offset. Returns false when the model or the clip is too large for the GPU path.
+bool BuildCrowd()
 {
-	if (boneMapping.find(node->mName.C_Str()) == boneMapping.end())
+	ReleaseCrowd();
+	if (!character || !characterBuffers.gpuSkinningSupported || character->duration <= 0)
 	{
-		boneMapping.insert(std::make_pair(node->mName.C_Str(), bones.size()));
-		bones.push_back({aiMatrix4x4(), {}, {}, -1});
+		std::cout << "Crowd mode needs GPU skinning and an animation" << std::endl;
+		return false;
 	}
-	
-	for (auto i = 0u; i < node->mNumChildren; i++)
+
+	const auto texelsPerBone = PALETTE_STRIDE / 4;
+	const auto duration = character->duration;
+	const auto& bones = character->bones;
+	const auto texelCount = static_cast<size_t>(duration) * bones.size() * texelsPerBone;
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	if (texelCount > static_cast<size_t>(maxTexels))
 	{
-		FindBones(node->mChildren[i], boneMapping);
+		std::cout << "Crowd clip needs " << texelCount << " texels, texture buffers hold at most " << maxTexels << std::endl;
+		return false;
 	}
-}
 
-void FindBones(const aiScene* scene, std::unordered_map<std::string, int>& boneMapping)
-{
-	for (auto i = 0u; i < scene->mNumMeshes; i++)
+	std::vector<float> palette(texelCount * 4);
+	auto output = palette.data();
+	BoundingBox clipBounds{};
+	for (auto tick = 0; tick < duration; tick++)
 	{
-		for (auto j = 0u; j < scene->mMeshes[i]->mNumBones; j++)
+		const auto pose = character->poseCache.get(tick);
+		clipBounds.add(character->poseBounds(pose));
+		for (auto b = 0u; b < bones.size(); b++)
 		{
-			const auto& bone = scene->mMeshes[i]->mBones[j];
-			if (boneMapping.find(bone->mName.C_Str()) == boneMapping.end())
-			{
-				boneMapping.insert(std::make_pair(bone->mName.C_Str(), bones.size()));
-				bones.push_back({bone->mOffsetMatrix, {}, {}, -1});
-			}
+			output = std::copy(pose[b].m, pose[b].m + PALETTE_STRIDE, output);
 		}
 	}
 
-	FindBones(scene->mRootNode, boneMapping);
-
-	for (const auto& mapping : boneMapping)
+	glGenBuffers(1, &crowdPaletteBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, crowdPaletteBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, palette.size() * sizeof(float), palette.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &crowdPaletteTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, crowdPaletteTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, crowdPaletteBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	// Characters stand one model size apart, centred on the original character
+	const auto columns = static_cast<int>(std::ceil(std::sqrt(crowdSize)));
+	const auto& positions = character->positions;
+	const auto spacing = std::max(positions.max.x - positions.min.x, positions.max.z - positions.min.z);
+	// The middle of the crowd to its outermost characters
+	const auto spread = (columns - 1) * 0.5f * spacing;
+	crowdBounds = clipBounds;
+	crowdBounds.min -= aiVector3D(spread, 0, spread);
+	crowdBounds.max += aiVector3D(spread, 0, spread);
+	std::vector<CrowdInstance> instances(crowdSize);
+	for (auto i = 0; i < crowdSize; i++)
 	{
-		const auto node = scene->mRootNode->FindNode(mapping.first.data());
-		auto parent = node->mParent;
-		while (parent)
-		{
-			auto parentIndex = boneMapping.find(parent->mName.C_Str());
-			if (parentIndex == boneMapping.end())
-			{
-				parent = parent->mParent;
-			}
-			else
-			{
-				bones.at(mapping.second).parentIndex = parentIndex->second;
-				break;
-			}
-		}
+		auto& instance = instances[i];
+		std::fill(instance.transform, instance.transform + 16, 0.0f);
+		instance.transform[0] = instance.transform[5] = instance.transform[10] = instance.transform[15] = 1;
+		instance.transform[12] = (i % columns - (columns - 1) * 0.5f) * spacing;
+		instance.transform[14] = (i / columns - (columns - 1) * 0.5f) * spacing;
+		// Golden ratio steps spread the offsets evenly over the clip without neighbours moving in step
+		instance.timeOffset = static_cast<float>(std::fmod(i * 0.618034 * duration, duration));
 	}
-}
 
-aiNodeAnim* FindChannel(const aiAnimation* aiAnimation, const std::string& name)
-{
-	for (auto i = 0u; i < aiAnimation->mNumChannels; i++)
+	glGenBuffers(1, &crowdInstanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, crowdInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CrowdInstance), instances.data(), GL_STATIC_DRAW);
+	for (const auto& buffers : characterBuffers.meshes)
 	{
-		if (aiAnimation->mChannels[i]->mNodeName.C_Str() == name)
+		glBindVertexArray(buffers.gpuVertexArray);
+		for (auto column = 0; column < 4; column++)
 		{
-			return aiAnimation->mChannels[i];
+			glEnableVertexAttribArray(6 + column);
+			glVertexAttribPointer(6 + column, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance), reinterpret_cast<void*>(offsetof(CrowdInstance, transform) + column * 4 * sizeof(float)));
+			glVertexAttribDivisor(6 + column, 1);
 		}
+		glEnableVertexAttribArray(10);
+		glVertexAttribPointer(10, 1, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance), reinterpret_cast<void*>(offsetof(CrowdInstance, timeOffset)));
+		glVertexAttribDivisor(10, 1);
 	}
-	
-	throw std::exception{};
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	std::cout << "Crowd of " << crowdSize << " characters sharing " << palette.size() * sizeof(float) / (1024.0 * 1024.0) << " MB of baked clip" << std::endl;
+	return true;
 }
 
-void UpdateAnimationMatrices()
+// Loads a scene on the thread pool, leaving the current one on screen until the new one is ready to swap in.
+// Requests made while a scene is loading are ignored.
+void RequestScene(int newSceneId)
 {
-	bones.clear();
-	animationMatrices.clear();
-	vertexWeights.clear();
-
-	const auto sourceScene = (animationScene && !dwarfSpecial) ? animationScene : scene;
-
-	if (!sourceScene->mAnimations)
+	if (loading)
 	{
-		throw std::exception{};
+		std::cout << "Still loading, ignoring request" << std::endl;
+		return;
 	}
 
-	const auto anim = sourceScene->mAnimations[0];
-
-	if (round(anim->mDuration) != anim->mDuration)
+	currentSceneId = newSceneId;
+	if (currentSceneId < 0)
 	{
-		throw std::exception{};
+		currentSceneId = maxSceneId - 1;
+	}
+	if (currentSceneId >= maxSceneId)
+	{
+		currentSceneId = 0;
 	}
 
-	auto boneMapping = std::unordered_map<std::string, int>();
-	FindBones(scene, boneMapping);
-
-	vertexWeights.resize(scene->mNumMeshes);
-	for (auto i = 0u; i < scene->mNumMeshes; i++)
+	// The loading thread works from a copy of the settings, so keys pressed meanwhile cannot change them halfway
+	const auto sceneId = currentSceneId;
+	const auto special = dwarfSpecial;
+	const auto bake = bakeAnimation;
+	const auto compress = compressAnimation;
+	const auto parallel = parallelBake;
+	const auto cacheSize = poseCacheSize;
+	const auto tolerance = clipTolerance;
+	const auto path = skinningPath;
+
+	loading = true;
+	loadProgress = 0;
+	threadPool.submit([=]
 	{
-		auto& meshVertexWeights = vertexWeights.at(i);
-		meshVertexWeights.resize(scene->mMeshes[i]->mNumVertices);
-		
-		for (auto j = 0u; j < scene->mMeshes[i]->mNumBones; j++)
+		try
 		{
-			const auto& bone = scene->mMeshes[i]->mBones[j];
-			auto boneIndex = boneMapping.find(bone->mName.C_Str())->second;
-			for (auto k = 0u; k < bone->mNumWeights; k++)
+			auto loaded = std::make_unique<Character>();
+			const auto source = sceneSource(sceneId, special);
+			// A corrupt cooked file is imported past like a stale one, as the cooker does, on a fresh character
+			// as the failed load may have left it pointing into the unmapped file
+			auto cooked = false;
+			try
 			{
-				const auto& weight = bone->mWeights[k];
-				meshVertexWeights.at(weight.mVertexId).push_back(std::make_pair(weight.mWeight, boneIndex));
+				cooked = loaded->loadCooked(source, 1000.0 / timeStep);
 			}
-		}
-	}
+			catch (const std::exception&)
+			{
+				std::cout << "Cooked file " << source.cookedFile() << " is corrupt, importing " << source.modelFile << std::endl;
+				loaded = std::make_unique<Character>();
+			}
+			if (!cooked)
+			{
+				loaded->importScene(source, 1000.0 / timeStep);
+			}
+			loadProgress = 0.2f;
 
-	animationMatrices.resize(boneMapping.size());
-	for (const auto& mapping : boneMapping)
-	{
-		const auto node = scene->mRootNode->FindNode(mapping.first.data());
-		animationMatrices.at(mapping.second) = std::vector<aiMatrix4x4>(static_cast<int>(anim->mDuration), node->mTransformation);
-	}
-	
-	for (auto i = 0u; i < anim->mNumChannels; i++)
-	{
-		const auto ndAnim = anim->mChannels[i];
-		const auto mapping = boneMapping.find(ndAnim->mNodeName.C_Str());
-		if (mapping == boneMapping.end())
-		{
-			__debugbreak();
-		}
+			loaded->decodeTextures(source.directory(), threadPool);
+			loadProgress = 0.4f;
 
-		auto remapped = dwarfRemapping.find(ndAnim->mNodeName.C_Str());
-		if (dwarfSpecial && remapped != dwarfRemapping.end())
-		{
-			for (auto j = 0; j < anim->mDuration; j++)
+			if (compress)
 			{
-				const auto remappedAnim = animationScene->mAnimations[0];
-				const auto remappedChannel = FindChannel(remappedAnim, remapped->second);
-				auto remappedTime = (float(j) / anim->mDuration) * remappedAnim->mDuration;
-				aiMatrix4x4 scale{};
-				aiMatrix4x4::Scaling(aiVector3D(1, 0.6, 1), scale);
-				animationMatrices.at(mapping->second).at(j) = GetKeyframe(remappedChannel, remappedTime) * scale;
+				loaded->compress(tolerance, threadPool);
 			}
-		}
-		else
-		{
-			for (auto j = 0; j < anim->mDuration; j++)
+			loaded->bake(bake, cacheSize, parallel ? &threadPool : nullptr);
+			loadProgress = 0.7f;
+
+			loaded->buildSkinnedMeshes();
+			loaded->reportSkinning(path);
+			// Cooked bounds were computed by the cooker
+			if (!cooked)
 			{
-				animationMatrices.at(mapping->second).at(j) = GetKeyframe(anim->mChannels[i], j);
+				loaded->computeBounds();
 			}
-		}
-	}
+			loadProgress = 0.8f;
 
-	for (const auto& mapping : boneMapping)
-	{
-		const auto node = scene->mRootNode->FindNode(mapping.first.data());
-		bones.at(mapping.second).matrix.resize(static_cast<int>(anim->mDuration));
-		bones.at(mapping.second).invmatrix.resize(static_cast<int>(anim->mDuration));
-		for (auto i = 0; i < static_cast<int>(anim->mDuration); i++)
+			std::lock_guard<std::mutex> lock{loadMutex};
+			loadedCharacter = std::move(loaded);
+		}
+		catch (const std::exception&)
 		{
-			bones.at(mapping.second).matrix.at(i) = FindMatrix(boneMapping, node, i) * bones.at(mapping.second).offsetMatrix;
-			bones.at(mapping.second).invmatrix.at(i) = bones.at(mapping.second).matrix.at(i);
-			bones.at(mapping.second).invmatrix.at(i).Transpose().Inverse();
+			std::cout << "Failed to load scene " << sceneId << std::endl;
+			loading = false;
 		}
-	}
+	});
 }
 
-void get_bounding_box()
+// Creates the GL objects of a loaded character, one texture or mesh per call so a frame never stalls on a whole
+// model, then swaps it in for the current character
+void FinalizeLoad()
 {
-    positions.min = aiVector3D(+1e10f);
-    positions.max = aiVector3D(-1e10f);
-
-    for (auto n = 0u; n < scene->mNumMeshes; ++n)
-    {
-        const aiMesh* mesh = scene->mMeshes[n];
-        const auto& meshWeights = vertexWeights.at(n);
-
-        for (auto k = 0u; k < mesh->mNumFaces; k++) {
-            const auto face = &mesh->mFaces[k];
-            for (auto i = 0u; i < face->mNumIndices; i++) {
-                const int vertexIndex = face->mIndices[i];
-                const auto &vertexWeight = meshWeights.at(vertexIndex);
-                aiVector3D tmp = aiVector3D();
-                for (auto weight : vertexWeight)
-                {
-                    tmp += bones.at(weight.second).matrix.at(currTick) * mesh->mVertices[vertexIndex] * weight.first;
-                }
-
-                positions.min.x = std::min(positions.min.x, tmp.x);
-                positions.min.y = std::min(positions.min.y, tmp.y);
-                positions.min.z = std::min(positions.min.z, tmp.z);
-
-                positions.max.x = std::max(positions.max.x, tmp.x);
-                positions.max.y = std::max(positions.max.y, tmp.y);
-                positions.max.z = std::max(positions.max.z, tmp.z);
-            }
-        }
-    }
-
-	auto tmp = positions.max.x - positions.min.x;
-	tmp = std::max(positions.max.y - positions.min.y, tmp);
-	tmp = std::max(positions.max.z - positions.min.z, tmp);
-	positions.scale = 1.0f / tmp;
-
-    positions.center = ((positions.max - positions.min) * 0.5f + positions.min) * positions.scale;
-}
-
-void cleanup_mannequin() {
-    for (auto i = 0u; i < scene->mRootNode->mNumChildren; i++) {
-        scene->mRootNode->mChildren[i]->mTransformation = aiMatrix4x4();
-    }
-
-    for (auto i = 0u; i < animationScene->mAnimations[0]->mNumChannels; i++)
-    {
-        auto channel = animationScene->mAnimations[0]->mChannels[i];
-        if (channel->mNodeName == aiString("free3dmodel_skeleton"))
-        {
-            for (auto j = 0u; j < channel->mNumPositionKeys; j++) {
-                channel->mPositionKeys[j].mValue = channel->mPositionKeys[j].mValue / 100.0f;
-                movementDeltas[j] = channel->mPositionKeys[j].mValue;
-            }
-        }
-    }
-
-//	printSceneInfo(scene);
-//    printMeshInfo(scene);
-//    printTreeInfo(scene->mRootNode);
-//    printBoneInfo(scene);
-//    printAnimInfo(animationScene);  //WARNING:  This may generate a lengthy output if the model has animation data
-}
+	if (!pendingCharacter)
+	{
+		std::lock_guard<std::mutex> lock{loadMutex};
+		if (!loadedCharacter)
+		{
+			return;
+		}
+		pendingCharacter = std::move(loadedCharacter);
+		pendingBuffers = {};
+		pendingBuffers.gpuSkinningSupported = pendingCharacter->bones.size() <= maxGpuBones;
+		pendingStep = 0;
+		if (!pendingBuffers.gpuSkinningSupported)
+		{
+			std::cout << pendingCharacter->bones.size() << " bones, GPU skinning supports at most " << maxGpuBones << std::endl;
+		}
+	}
 
-void loadScene(int newSceneId)
-{
-	movementDeltas = std::vector<aiVector3D>(1000, aiVector3D());
-	currTick = 0;
-	currentSceneId = newSceneId;
-	if (currentSceneId < 0)
+	const auto textureCount = pendingCharacter->textures.size();
+	const auto steps = textureCount + pendingCharacter->meshes.size();
+	if (pendingStep < textureCount)
 	{
-		currentSceneId = maxSceneId - 1;
+		UploadTexture(pendingCharacter->textures[pendingStep], pendingBuffers);
 	}
-	if (currentSceneId >= maxSceneId)
+	else if (pendingStep < steps)
 	{
-		currentSceneId = 0;
+		BuildMeshBuffers(*pendingCharacter, static_cast<unsigned int>(pendingStep - textureCount), pendingBuffers);
+	}
+	pendingStep++;
+	loadProgress = 0.8f + 0.2f * pendingStep / (steps + 1);
+	if (pendingStep <= steps)
+	{
+		return;
 	}
 
-	switch (currentSceneId)
+	// The old character's streaming regions are no longer drawn, so their fences can go with them
+	for (auto& fence : streamFences)
 	{
-	case 0:
-		loadModel("data2/ArmyPilot/ArmyPilot.x", "");
-		break;
-	case 1:
-		loadModel("data2/Mannequin/mannequin.fbx", "data2/Mannequin/run.fbx");
-		cleanup_mannequin();
-		break;
-	case 2:
-		if (dwarfSpecial)
-		{
-			loadModel("data2/Dwarf/dwarf.x", "data2/Dwarf/avatar_walk.bvh");
-		}
-		else
+		if (fence)
 		{
-			loadModel("data2/Dwarf/dwarf.x", "");
+			glDeleteSync(fence);
+			fence = nullptr;
 		}
-		break;
+	}
+	ReleaseCharacterBuffers(characterBuffers);
+	std::swap(characterBuffers, pendingBuffers);
+	pendingCharacter->textures.clear();
+	character = std::move(pendingCharacter);
+	currTime = 0;
 
-	default:
-		throw std::exception{};
+	if (!characterBuffers.gpuSkinningSupported)
+	{
+		gpuSkinning = false;
+	}
+	if (crowdMode)
+	{
+		crowdMode = BuildCrowd();
 	}
+	loading = false;
+}
 
-	UpdateAnimationMatrices();
+// Shows how far the loading scene has got over the top of the current one
+void drawLoadingIndicator()
+{
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_DEPTH_TEST);
 
-	get_bounding_box();
+	const auto text = "Loading scene... " + std::to_string(static_cast<int>(loadProgress * 100)) + "%";
+	glColor4f(0, 0, 0, 1);
+	glRasterPos2f(-0.95f, 0.9f);
+	glutBitmapString(GLUT_BITMAP_HELVETICA_18, reinterpret_cast<const unsigned char*>(text.c_str()));
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
 }
 
 void initialise()
@@ -722,7 +785,42 @@ void initialise()
 	glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, 50);
 	glColor4fv(materialCol);
 	
-	loadScene(currentSceneId);
+	skinningShader = std::make_unique<Shader>("data/skinning.vert", "data/skinning.frag");
+	crowdShader = std::make_unique<Shader>("data/crowd.vert", "data/skinning.frag");
+	streamShader = std::make_unique<Shader>("data/stream.vert", "data/skinning.frag");
+
+	// Linear filtering with depth comparison gives 2x2 filtered lookups, a border of 1 leaves everything outside lit
+	const float border[4]{1, 1, 1, 1};
+	glGenTextures(1, &shadowMapTexture);
+	glBindTexture(GL_TEXTURE_2D, shadowMapTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, shadowMapSize, shadowMapSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &shadowFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMapTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Shadow map framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(1, &paletteBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, paletteBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, maxGpuBones * PALETTE_STRIDE * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, paletteBuffer);
+
+	RequestScene(currentSceneId);
 	
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
@@ -745,12 +843,9 @@ void initialise()
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, colour);
 }
 
-void update(int)
+// Advances the clip by deltaTime milliseconds, moving the camera for any keys held down
+void step(int deltaTime)
 {
-	const auto timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
-	const auto deltaTime = timeSinceStart - oldTimeSinceStart;
-	oldTimeSinceStart = timeSinceStart;
-
 	const auto delta = deltaTime * 0.001f;
 	
 	if (specialKeyState[GLUT_KEY_LEFT])
@@ -789,14 +884,29 @@ void update(int)
 		}
 	}
 
-	currTick++;
-	if (currTick >= tDuration)
+	if (character && character->duration > 0)
 	{
-		currTick = 0;
+		currTime = fmod(currTime + deltaTime * 0.001 * character->ticksPerSecond, character->duration);
 	}
-	
+}
+
+void update(int)
+{
+	const auto timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
+	const auto deltaTime = timeSinceStart - oldTimeSinceStart;
+	oldTimeSinceStart = timeSinceStart;
+
+	step(deltaTime);
 	glutPostRedisplay();
-	glutTimerFunc(timeStep, update, 0);
+	if (!uncappedFrameRate)
+	{
+		glutTimerFunc(timeStep, update, 0);
+	}
+}
+
+void idle()
+{
+	update(0);
 }
 
 void keyboardCallback(unsigned char key, int x, int y)
@@ -804,23 +914,52 @@ void keyboardCallback(unsigned char key, int x, int y)
 	if (key == '1' && currentSceneId == 2)
 	{
 		dwarfSpecial = false;
-		loadScene(2);
+		RequestScene(2);
 	}
 	if (key == '2' && currentSceneId == 2)
 	{
 		dwarfSpecial = true;
-		loadScene(2);
+		RequestScene(2);
 	}
 
 	if (key == '-')
 	{
 		dwarfSpecial = false;
-		loadScene(currentSceneId - 1);
+		RequestScene(currentSceneId - 1);
 	}
 	if (key == '=')
 	{
 		dwarfSpecial = false;
-		loadScene(currentSceneId + 1);
+		RequestScene(currentSceneId + 1);
+	}
+
+	if (key == 'g')
+	{
+		gpuSkinning = !gpuSkinning && characterBuffers.gpuSkinningSupported;
+		std::cout << "Using " << (gpuSkinning ? "GPU" : skinningPathName(skinningPath)) << " skinning" << std::endl;
+	}
+
+	if (key == 'i')
+	{
+		directSampling = !directSampling;
+		std::cout << (directSampling ? "Sampling keys directly" : "Blending cached poses") << std::endl;
+	}
+
+	if (key == 'm')
+	{
+		crowdMode = !crowdMode && BuildCrowd();
+	}
+
+	if (key == 'c')
+	{
+		compressAnimation = !compressAnimation;
+		RequestScene(currentSceneId);
+	}
+
+	if (key == 'p')
+	{
+		bakeAnimation = !bakeAnimation;
+		RequestScene(currentSceneId);
 	}
 
 	keyState[key] = true;
@@ -846,11 +985,46 @@ void specialUpCallback(int key, int, int) {
 	}
 }
 
+// Reads back a fixed function matrix, which GL keeps column-major
+aiMatrix4x4 GetMatrix(GLenum matrixName)
+{
+	float matrix[16];
+	glGetFloatv(matrixName, matrix);
+	return aiMatrix4x4(
+		matrix[0], matrix[4], matrix[8], matrix[12],
+		matrix[1], matrix[5], matrix[9], matrix[13],
+		matrix[2], matrix[6], matrix[10], matrix[14],
+		matrix[3], matrix[7], matrix[11], matrix[15]);
+}
+
+// Binds a program lighting with light 0 and the shadow map, or writing depth alone for the shadow map itself
+void UseProgram(GLuint program, bool depthOnly, bool lighting)
+{
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "depthOnly"), depthOnly);
+	glUniform1i(glGetUniformLocation(program, "lighting"), lighting);
+	glUniform4fv(glGetUniformLocation(program, "shadowColour"), 1, shadowColour);
+	if (depthOnly)
+	{
+		return;
+	}
+
+	// Eye space back to the world, then into the light's clip space and on to shadow map texture coordinates
+	const aiMatrix4x4 bias(
+		0.5f, 0, 0, 0.5f,
+		0, 0.5f, 0, 0.5f,
+		0, 0, 0.5f, 0.5f,
+		0, 0, 0, 1);
+	const auto shadowMatrix = bias * lightProjection * lightView * eyeToWorld;
+	glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrix"), 1, GL_TRUE, &shadowMatrix.a1);
+}
+
 void drawPlane()
 {
 	glColor4f(1, 1, 1, 1);
-	glDisable(GL_LIGHTING);
-	glEnable(GL_TEXTURE_2D);
+	UseProgram(streamShader->program, false, false);
+	glUniform1i(glGetUniformLocation(streamShader->program, "useTexture"), true);
+	glUniform1i(glGetUniformLocation(streamShader->program, "useVertexColour"), false);
 	glBindTexture(GL_TEXTURE_2D, floorTexture);
 	
 	glBegin(GL_QUADS);
@@ -868,111 +1042,180 @@ void drawPlane()
 	glVertex3f(100, 0, -100);
 	
 	glEnd();
-	glEnable(GL_LIGHTING);
+	glUseProgram(0);
 }
 
-void normalise(const float input[4], float output[4])
+// Transform renderScene places the model with, so the character's feet rest on the floor
+aiVector3D ModelToWorld(const ScenePositions& positions, const aiVector3D& point)
 {
-	const auto size = std::sqrt(input[0] * input[0] +
-		input[1] * input[1] +
-		input[2] * input[2] +
-		input[3] * input[3]);
-	output[0] = input[0] / size;
-	output[1] = input[1] / size;
-	output[2] = input[2] / size;
-	output[3] = input[3] / size;
+	return aiVector3D(0, -positions.min.y * positions.scale, 0) + (point - positions.center) * positions.scale;
 }
 
-static void createShadowMatrix(const float ground[4], const float xlight[4])
+void renderScene(const Character& sc, bool depthOnly)
 {
-	float shadowMat[4][4]
-	{
-	};
-
-	float light[4];
-	normalise(xlight, light);
+	const auto& positions = sc.positions;
+	glPushMatrix();
 
-	const auto dot = ground[0] * light[0] +
-		ground[1] * light[1] +
-		ground[2] * light[2] +
-		ground[3] * light[3];
+	glTranslatef(0, -positions.min.y * positions.scale, 0);
 
-	shadowMat[0][0] = dot - light[0] * ground[0];
-	shadowMat[1][0] = 0.0 - light[0] * ground[1];
-	shadowMat[2][0] = 0.0 - light[0] * ground[2];
-	shadowMat[3][0] = 0.0 - light[0] * ground[3];
+	// scale the whole asset to fit into our view frustum
+	glScalef(positions.scale, positions.scale, positions.scale);
 
-	shadowMat[0][1] = 0.0 - light[1] * ground[0];
-	shadowMat[1][1] = dot - light[1] * ground[1];
-	shadowMat[2][1] = 0.0 - light[1] * ground[2];
-	shadowMat[3][1] = 0.0 - light[1] * ground[3];
+//	const float xc = (scene_min.x + scene_max.x) * 0.5;
+//	const float yc = (scene_min.y + scene_max.y) * 0.5;
+//	const float zc = (scene_min.z + scene_max.z) * 0.5;
+	// center the model
+//	glTranslatef(-xc, -yc, -zc);
+	glTranslatef(-positions.center.x, -positions.center.y, -positions.center.z);
 
-	shadowMat[0][2] = 0.0 - light[2] * ground[0];
-	shadowMat[1][2] = 0.0 - light[2] * ground[1];
-	shadowMat[2][2] = dot - light[2] * ground[2];
-	shadowMat[3][2] = 0.0 - light[2] * ground[3];
+	const auto program = crowdMode ? crowdShader->program : gpuSkinning ? skinningShader->program : streamShader->program;
+	UseProgram(program, depthOnly, true);
+	if (crowdMode)
+	{
+		glUniform1f(glGetUniformLocation(program, "time"), static_cast<float>(currTime));
+		glUniform1i(glGetUniformLocation(program, "duration"), sc.duration);
+		glUniform1i(glGetUniformLocation(program, "boneCount"), sc.bones.size());
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_BUFFER, crowdPaletteTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
 
-	shadowMat[0][3] = 0.0 - light[3] * ground[0];
-	shadowMat[1][3] = 0.0 - light[3] * ground[1];
-	shadowMat[2][3] = 0.0 - light[3] * ground[2];
-	shadowMat[3][3] = dot - light[3] * ground[3];
+	render(sc, characterBuffers, program, depthOnly);
 
-	glMultMatrixf(reinterpret_cast<const GLfloat*>(shadowMat));
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glPopMatrix();
 }
 
-void renderScene(bool shadow)
+// Renders the character's depth from the light into the shadow map, with an orthographic frustum fitted tightly
+// around this frame's bounds so the map's resolution is spent on the character
+void renderShadowMap(const Character& sc)
 {
-	if (shadow)
+	const auto& positions = sc.positions;
+	const auto& bounds = crowdMode ? crowdBounds : sc.frameBounds;
+	if (bounds.empty())
 	{
-		glDisable(GL_LIGHTING);
+		return;
 	}
-	else
+
+	const auto centre = ModelToWorld(positions, (bounds.min + bounds.max) * 0.5f);
+	const auto toLight = aiVector3D(lightPosn[0], lightPosn[1], lightPosn[2]).Normalize();
+	const auto up = std::abs(toLight.y) > 0.99f ? aiVector3D(0, 0, 1) : aiVector3D(0, 1, 0);
+	const auto eye = centre + toLight;
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	gluLookAt(eye.x, eye.y, eye.z, centre.x, centre.y, centre.z, up.x, up.y, up.z);
+	lightView = GetMatrix(GL_MODELVIEW_MATRIX);
+
+	BoundingBox lightBounds{};
+	for (auto corner = 0; corner < 8; corner++)
 	{
-		glEnable(GL_LIGHTING);
+		const aiVector3D point(corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y, corner & 4 ? bounds.max.z : bounds.min.z);
+		lightBounds.add(lightView * ModelToWorld(positions, point));
 	}
-	glPushMatrix();
 
-	glTranslatef(0, -positions.min.y * positions.scale, 0);
+	// The view looks down -z. Receivers beyond the far plane, like the floor under the character, read as occluded.
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(lightBounds.min.x, lightBounds.max.x, lightBounds.min.y, lightBounds.max.y, -lightBounds.max.z, -lightBounds.min.z);
+	lightProjection = GetMatrix(GL_PROJECTION_MATRIX);
+	glMatrixMode(GL_MODELVIEW);
 
-	// scale the whole asset to fit into our view frustum
-	glScalef(positions.scale, positions.scale, positions.scale);
+	// Headless runs draw into their own framebuffer rather than the window's
+	GLint viewport[4];
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowFramebuffer);
+	glViewport(0, 0, shadowMapSize, shadowMapSize);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2, 4);
+
+	renderScene(sc, true);
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-//	const float xc = (scene_min.x + scene_max.x) * 0.5;
-//	const float yc = (scene_min.y + scene_max.y) * 0.5;
-//	const float zc = (scene_min.z + scene_max.z) * 0.5;
-	// center the model
-//	glTranslatef(-xc, -yc, -zc);
-	glTranslatef(-positions.center.x, -positions.center.y, -positions.center.z);
-
-	render(scene, shadow);
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
 	glPopMatrix();
 }
 
-void display()
+void renderFrame()
 {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	FinalizeLoad();
+
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
-	gluLookAt(sin(AI_DEG_TO_RAD(angle)) * distance,
-              positions.center.y + distance / 2,
-	          cos(AI_DEG_TO_RAD(angle)) * distance + movementDeltas[currTick].z * positions.scale,
-              positions.center.x,
-              positions.center.y,
-              positions.center.z + movementDeltas[currTick].z * positions.scale,
+	// Crowd instances pose themselves from the baked clip
+	if (character && gpuSkinning && !crowdMode)
+	{
+		UploadPalette(*character, currTime);
+	}
+	else if (character && !crowdMode)
+	{
+		SkinMeshes(*character, characterBuffers, currTime);
+	}
+
+	if (character)
+	{
+		renderShadowMap(*character);
+	}
+
+	// Follow this frame's bounds, placed in the world as renderScene places the model, so clips that move stay framed
+	auto target = aiVector3D();
+	if (character)
+	{
+		const auto& positions = character->positions;
+		const auto& bounds = crowdMode ? crowdBounds : character->frameBounds;
+		const auto centre = (bounds.min + bounds.max) * 0.5f;
+		target = ModelToWorld(positions, centre);
+	}
+	gluLookAt(target.x + sin(AI_DEG_TO_RAD(angle)) * distance,
+	          target.y + distance / 2,
+	          target.z + cos(AI_DEG_TO_RAD(angle)) * distance,
+	          target.x,
+	          target.y,
+	          target.z,
 	          0, 1, 0);
 	glLightfv(GL_LIGHT0, GL_POSITION, lightPosn);
+	eyeToWorld = GetMatrix(GL_MODELVIEW_MATRIX);
+	eyeToWorld.Inverse();
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, shadowMapTexture);
+	glActiveTexture(GL_TEXTURE0);
 
 	drawPlane();
-	renderScene(false);
+	if (character)
+	{
+		renderScene(*character, false);
 
-	glTranslatef(0, 0.0001, 0);
-	glScalef(1, 0, 1);
+		if (!gpuSkinning && !crowdMode)
+		{
+			FenceStreamRegion();
+		}
+	}
 
-	float ground[4]{0, 1, 0, 0};
-	createShadowMatrix(ground, lightPosn);
-	renderScene(true);
+	if (loading)
+	{
+		drawLoadingIndicator();
+	}
+}
 
+void display()
+{
+	renderFrame();
 	glutSwapBuffers();
 }
 
@@ -981,6 +1224,30 @@ int main(int argc, char** argv)
 	/* initialization of DevIL */
 	ilInit();
 
+	skinningPath = bestSkinningPath();
+	std::cout << "Using " << skinningPathName(skinningPath) << " skinning" << std::endl;
+
+	const auto headless = parseHeadlessOptions(argc, argv);
+	if (headless.enabled())
+	{
+		HeadlessContext context(800, 600, 4, 2, false);
+		initialise();
+		// Frames are timed from the first one with the scene on screen, after it has loaded and been uploaded
+		while (loading)
+		{
+			FinalizeLoad();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		const auto succeeded = runHeadless(headless, context, [](int)
+		{
+			step(timeStep);
+			renderFrame();
+		});
+		ReleaseCharacterBuffers(characterBuffers);
+		character.reset();
+		return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
 	glutInitWindowSize(800, 600);
@@ -989,15 +1256,34 @@ int main(int argc, char** argv)
 	glutSetKeyRepeat(false);
 	glutCreateWindow("COSC 422 Assignment 2 - MJS351 - Animation");
 
+	if (glewInit() == GLEW_OK)
+	{
+		std::cout << "GLEW initialization successful! " << std::endl;
+		std::cout << " Using GLEW version " << glewGetString(GLEW_VERSION) << std::endl;
+	}
+	else
+	{
+		std::cerr << "Unable to initialize GLEW  ...exiting." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
 	initialise();
 	glutDisplayFunc(display);
-	glutTimerFunc(50, update, 0);
+	if (uncappedFrameRate)
+	{
+		glutIdleFunc(idle);
+	}
+	else
+	{
+		glutTimerFunc(timeStep, update, 0);
+	}
 	glutKeyboardFunc(keyboardCallback);
 	glutKeyboardUpFunc(keyboardUpCallback);
 	glutSpecialFunc(specialCallback);
 	glutSpecialUpFunc(specialUpCallback);
 	glutMainLoop();
 
-	aiReleaseImport(scene);
+	ReleaseCharacterBuffers(characterBuffers);
+	character.reset();
 }
 
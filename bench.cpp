@@ -0,0 +1,417 @@
+//  ========================================================================
+//  COSC422: Advanced Computer Graphics;  University of Canterbury (2019)
+//  ========================================================================
+
+// Times the CPU hot paths of the three programs on the shipped data, without a window or GL context, and writes the
+// results as JSON to stdout so a machine without a GPU can catch regressions. Progress goes to stderr.
+//
+//   cosc422-bench [--filter text] [--warmup count] [--repetitions count] [--output file]
+
+#include <IL/il.h>
+// Only for the declarations loadTGA.h needs, nothing here calls into GL
+#include <GL/gl.h>
+
+#include "character.h"
+#include "assimp_extras.h"
+#include "loadTGA.h"
+#include "patch_file.h"
+#include "scenes.h"
+#include "terrain_grid.h"
+#include "terrain_quadtree.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Results are added here so the optimiser cannot drop the work being timed
+volatile float sink = 0;
+
+// Swallows the progress the loaders print to std::cout, which must hold nothing but the JSON
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c) override
+	{
+		return traits_type::not_eof(c);
+	}
+};
+
+struct BenchmarkResult
+{
+	std::string name;
+	// Units of work per operation, such as vertices or keys, so results can be compared per item
+	double items;
+	// Operations timed together in each sample, so short operations still span many clock ticks
+	int batch;
+	// Nanoseconds per operation, sorted
+	std::vector<double> samples;
+};
+
+class Benchmarks
+{
+public:
+	Benchmarks(int warmup, int repetitions, std::string filter)
+		: warmup(warmup), repetitions(repetitions), filter(std::move(filter))
+	{
+	}
+
+	bool enabled(const std::string& name) const
+	{
+		return filter.empty() || name.find(filter) != std::string::npos;
+	}
+
+	template <typename Operation>
+	void run(const std::string& name, double items, Operation&& operation)
+	{
+		if (!enabled(name))
+		{
+			return;
+		}
+		std::cerr << "Running " << name << std::endl;
+
+		// Batch operations shorter than a millisecond, capped so a sample never takes much longer than that
+		const auto once = time(operation, 1);
+		const auto batch = static_cast<int>(std::min(std::max(minimumSampleTime / std::max(once, 1.0), 1.0), 1e6));
+
+		for (auto i = 0; i < warmup; i++)
+		{
+			time(operation, batch);
+		}
+
+		BenchmarkResult result{name, items, batch, {}};
+		for (auto i = 0; i < repetitions; i++)
+		{
+			result.samples.push_back(time(operation, batch) / batch);
+		}
+		std::sort(result.samples.begin(), result.samples.end());
+		results.push_back(std::move(result));
+	}
+
+	void writeJson(std::ostream& output) const
+	{
+		output << std::setprecision(6) << std::fixed;
+		output << "{\n";
+		output << "  \"unit\": \"ns\",\n";
+		output << "  \"warmup\": " << warmup << ",\n";
+		output << "  \"repetitions\": " << repetitions << ",\n";
+		output << "  \"benchmarks\": [";
+		for (auto i = 0u; i < results.size(); i++)
+		{
+			const auto& result = results[i];
+			const auto& samples = result.samples;
+			const auto count = samples.size();
+			auto mean = 0.0;
+			for (auto sample : samples)
+			{
+				mean += sample / count;
+			}
+			const auto median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+			// Nearest rank, so with fewer than 100 samples this is the slowest one
+			const auto p99 = samples[std::min(count - 1, static_cast<std::size_t>(std::ceil(count * 0.99)) - 1)];
+
+			output << (i > 0 ? "," : "") << "\n    {";
+			output << "\"name\": \"" << result.name << "\", ";
+			output << "\"items\": " << result.items << ", ";
+			output << "\"batch\": " << result.batch << ", ";
+			output << "\"min\": " << samples.front() << ", ";
+			output << "\"median\": " << median << ", ";
+			output << "\"mean\": " << mean << ", ";
+			output << "\"p99\": " << p99 << ", ";
+			output << "\"max\": " << samples.back() << ", ";
+			output << "\"median_per_item\": " << (result.items > 0 ? median / result.items : 0.0) << "}";
+		}
+		output << "\n  ]\n}\n";
+	}
+
+private:
+	static constexpr double minimumSampleTime = 1e6;
+
+	int warmup;
+	int repetitions;
+	std::string filter;
+	std::vector<BenchmarkResult> results{};
+
+	// Nanoseconds taken by count calls
+	template <typename Operation>
+	static double time(Operation& operation, int count)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (auto i = 0; i < count; i++)
+		{
+			operation();
+		}
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count();
+	}
+};
+
+void benchmarkPatchFiles(Benchmarks& benchmarks)
+{
+	for (const std::string fileName : {"PatchVerts_Teapot.txt", "PatchVerts_Gumbo.txt"})
+	{
+		const auto path = "data/" + fileName;
+		auto numberVertices = 0;
+		loadPatchFile(path, numberVertices);
+		benchmarks.run("bezier/load_patch_file/" + fileName, numberVertices, [&path]
+		{
+			auto count = 0;
+			const auto vertices = loadPatchFile(path, count);
+			sink = sink + vertices[count - 1].x;
+		});
+	}
+}
+
+void benchmarkTga(Benchmarks& benchmarks)
+{
+	const std::string path = "data/HeightMap1.tga";
+	TGAImage image;
+	if (!readTGA(path, image))
+	{
+		throw std::exception{};
+	}
+	benchmarks.run("tga/read/HeightMap1.tga", image.wid * image.hgt, [&path]
+	{
+		TGAImage decoded;
+		readTGA(path, decoded);
+		sink = sink + decoded.imageData.back();
+	});
+}
+
+void benchmarkTerrainGrid(Benchmarks& benchmarks)
+{
+	// The size the terrain viewer uses, then one large enough for the grid to dominate
+	for (auto gridSize : {9, 256})
+	{
+		benchmarks.run("terrain/grid/" + std::to_string(gridSize), (gridSize + 1) * (gridSize + 1), [gridSize]
+		{
+			const auto grid = buildTerrainGrid(gridSize, 50.0f);
+			sink = sink + grid.vertices.back().x + grid.indices.back();
+		});
+	}
+}
+
+void benchmarkTerrainQuadtree(Benchmarks& benchmarks)
+{
+	if (!benchmarks.enabled("terrain/quadtree/select/256"))
+	{
+		return;
+	}
+
+	// A grid fine enough for the walk to matter, seen from where the terrain viewer starts
+	const auto gridSize = 256;
+	const auto field = loadHeightField("data/HeightMap1.tga", 10.0f);
+	const TerrainQuadtree quadtree{field, buildRoughnessMap(field, 8), gridSize, 50.0f};
+	const TessellationDetail detail{300 / std::tan(30.0f * 3.14159265f / 180), 12.0f, 0.2f, 0.05f};
+	const glm::vec3 camera{0.0f, 15.0f, 20.0f};
+	const Frustum frustum{glm::perspectiveFov(60.0f * 3.14159265f / 180, 800.0f, 600.0f, 1.0f, 1000.0f) *
+	                      glm::lookAt(camera, glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f})};
+	std::vector<uint32_t> indices{};
+	benchmarks.run("terrain/quadtree/select/256", gridSize * gridSize, [&]
+	{
+		indices.clear();
+		quadtree.select(frustum, camera, detail, 2.0f, indices);
+		sink = sink + indices.size();
+	});
+}
+
+void benchmarkCharacter(Benchmarks& benchmarks, const SceneSource& source, ThreadPool& threadPool)
+{
+	auto name = source.cookedFile();
+	name = name.substr(name.find_last_of("/\\") + 1);
+	name = name.substr(0, name.size() - std::string(".cooked").size());
+
+	// Importing is the slowest part, so skip scenes none of whose benchmarks pass the filter
+	auto enabled = false;
+	for (const std::string benchmark : {"keyframes/%/sequential", "keyframes/%/random", "bake/%/serial", "bake/%/parallel",
+	                                    "skinning/%/Scalar", "skinning/%/SSE", "skinning/%/AVX2",
+	                                    "bounds/%/get_bounding_box", "bounds/%/pose_bounds"})
+	{
+		enabled = enabled || benchmarks.enabled(benchmark.substr(0, benchmark.find('%')) + name + benchmark.substr(benchmark.find('%') + 1));
+	}
+	if (!enabled)
+	{
+		return;
+	}
+
+	Character character{};
+	character.importScene(source, 30);
+	const auto duration = character.duration;
+	const auto& bindings = character.channelBindings;
+
+	// Every channel at every tick in order, as playback and baking walk the keys
+	const auto keyCount = static_cast<double>(duration) * bindings.size();
+	benchmarks.run("keyframes/" + name + "/sequential", keyCount, [&]
+	{
+		for (const auto& binding : bindings)
+		{
+			KeyframeCursor cursor{};
+			for (auto tick = 0; tick < duration; tick++)
+			{
+				sink = sink + sampleBinding(binding, tick, cursor, false).a4;
+			}
+		}
+	});
+
+	// The same samples in random order, so the cursor rarely helps and most lookups search
+	std::vector<double> times(duration);
+	std::mt19937 random{422};
+	std::uniform_real_distribution<double> distribution(0, duration);
+	for (auto& time : times)
+	{
+		time = distribution(random);
+	}
+	benchmarks.run("keyframes/" + name + "/random", keyCount, [&]
+	{
+		for (const auto& binding : bindings)
+		{
+			KeyframeCursor cursor{};
+			for (auto time : times)
+			{
+				sink = sink + sampleBinding(binding, time, cursor, false).a4;
+			}
+		}
+	});
+
+	benchmarks.run("bake/" + name + "/serial", duration, [&character]
+	{
+		character.bake(true, 0, nullptr);
+	});
+	benchmarks.run("bake/" + name + "/parallel", duration, [&character, &threadPool]
+	{
+		character.bake(true, 0, &threadPool);
+	});
+
+	character.bake(true, 0, &threadPool);
+	character.buildSkinnedMeshes();
+	character.updatePalette(duration / 2.0, false);
+	auto vertexCount = 0;
+	for (const auto& skinnedMesh : character.skinnedMeshes)
+	{
+		vertexCount += skinnedMesh.input.vertexCount;
+	}
+	for (auto path : {SkinningPath::Scalar, SkinningPath::SSE, SkinningPath::AVX2})
+	{
+		if (!skinningPathSupported(path))
+		{
+			continue;
+		}
+		benchmarks.run("skinning/" + name + "/" + skinningPathName(path), vertexCount, [&character, path]
+		{
+			for (auto& skinnedMesh : character.skinnedMeshes)
+			{
+				skinVertices(path, character.palette, skinnedMesh.input, skinnedMesh.output);
+			}
+			sink = sink + character.skinnedMeshes.front().output.positionX.front();
+		});
+	}
+
+	auto sceneVertexCount = 0u;
+	for (auto i = 0u; i < character.scene->mNumMeshes; i++)
+	{
+		sceneVertexCount += character.scene->mMeshes[i]->mNumVertices;
+	}
+	benchmarks.run("bounds/" + name + "/get_bounding_box", sceneVertexCount, [&character]
+	{
+		aiVector3D min, max;
+		get_bounding_box(character.scene, &min, &max);
+		sink = sink + max.x;
+	});
+
+	// What the viewer does per frame instead, from per bone boxes
+	const auto pose = character.poseCache.get(duration / 2);
+	benchmarks.run("bounds/" + name + "/pose_bounds", character.bones.size(), [&character, pose]
+	{
+		sink = sink + character.poseBounds(pose).max.x;
+	});
+}
+
+int main(int argc, char** argv)
+{
+	auto warmup = 3;
+	auto repetitions = 30;
+	std::string filter{};
+	std::string outputFile{};
+	for (auto i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--filter")
+		{
+			filter = argv[i + 1];
+		}
+		else if (option == "--warmup")
+		{
+			warmup = std::atoi(argv[i + 1]);
+		}
+		else if (option == "--repetitions")
+		{
+			repetitions = std::max(1, std::atoi(argv[i + 1]));
+		}
+		else if (option == "--output")
+		{
+			outputFile = argv[i + 1];
+		}
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	NullBuffer nullBuffer{};
+	const auto standardOutput = std::cout.rdbuf(&nullBuffer);
+
+	ilInit();
+	ThreadPool threadPool{};
+	Benchmarks benchmarks{warmup, repetitions, filter};
+	try
+	{
+		benchmarkPatchFiles(benchmarks);
+		benchmarkTga(benchmarks);
+		benchmarkTerrainGrid(benchmarks);
+		benchmarkTerrainQuadtree(benchmarks);
+
+		std::vector<std::string> benchmarkedFiles{};
+		for (auto sceneId = 0; sceneId < sceneCount; sceneId++)
+		{
+			for (auto dwarfSpecial : {false, true})
+			{
+				const auto source = sceneSource(sceneId, dwarfSpecial);
+				if (std::find(benchmarkedFiles.begin(), benchmarkedFiles.end(), source.cookedFile()) != benchmarkedFiles.end())
+				{
+					continue;
+				}
+				benchmarkedFiles.push_back(source.cookedFile());
+				benchmarkCharacter(benchmarks, source, threadPool);
+			}
+		}
+	}
+	catch (const std::exception&)
+	{
+		std::cerr << "Benchmark failed, is it running from the repository root?" << std::endl;
+		std::cout.rdbuf(standardOutput);
+		return EXIT_FAILURE;
+	}
+
+	std::cout.rdbuf(standardOutput);
+	if (outputFile.empty())
+	{
+		benchmarks.writeJson(std::cout);
+	}
+	else
+	{
+		std::ofstream file(outputFile);
+		benchmarks.writeJson(file);
+	}
+	return EXIT_SUCCESS;
+}
@@ -4,7 +4,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "headless.h"
 #include "model.h"
+#include "patch_file.h"
 #include "shader.h"
 
 bool keyState[256] = {};
@@ -70,7 +72,7 @@ public:
                 "data/bezier.tese",
                 "data/bezier.frag");
 
-        auto vertexData = loadModelData(inputFile, numberVertices);
+        auto vertexData = loadPatchFile(inputFile, numberVertices);
 
         // Send buffer data to GPU
         glNamedBufferStorage(buffers[VERTEX_BUFFER], sizeof(glm::vec3) * numberVertices, vertexData.get(), 0);
@@ -131,27 +133,6 @@ private:
     float rotateY{};
     float rotateX{};
     float scale{1};
-
-    static std::unique_ptr<glm::vec3[]> loadModelData(const std::string &inputFile, int& numberVertices) {
-        std::ifstream file(inputFile.c_str());
-        if(!file.good()) {
-            std::cerr << "Error opening patch file: " << inputFile << std::endl;
-            throw std::exception{};
-        }
-
-        file >> numberVertices;
-
-        auto vertexData = std::unique_ptr<glm::vec3[]>{new glm::vec3[numberVertices]};
-        for (auto i = 0; i < numberVertices; i++) {
-            float x, y, z;
-            file >> x >> y >> z;
-            vertexData[i] = glm::vec3{x, y, z};
-        }
-
-        file.close();
-
-        return vertexData;
-    }
 };
 
 void GLAPIENTRY debugCallback(GLenum source,
@@ -236,13 +217,8 @@ void initialise() {
     glClearColor(1, 1, 1, 1);
 }
 
-void update(int) {
-    int timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
-    int deltaTime = timeSinceStart - oldTimeSinceStart;
-    oldTimeSinceStart = timeSinceStart;
-
-    float delta = deltaTime * 0.001f;
-
+// Advances the scene by delta seconds, moving the camera for any keys held down
+void step(float delta) {
     if (specialKeyState[GLUT_KEY_UP]) {
         scene->getCamera().translate(glm::vec3{0, 0, -10 * delta});
     }
@@ -251,19 +227,45 @@ void update(int) {
     }
 
     scene->update(delta);
+}
+
+void update(int) {
+    int timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
+    int deltaTime = timeSinceStart - oldTimeSinceStart;
+    oldTimeSinceStart = timeSinceStart;
+
+    step(deltaTime * 0.001f);
     glutTimerFunc(50, update, 0);
     glutPostRedisplay();
 }
 
-void display() {
+void renderFrame() {
     glPolygonMode(GL_FRONT_AND_BACK, wireframeMode ? GL_LINE : GL_FILL);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     scene->render();
+}
+
+void display() {
+    renderFrame();
     glutSwapBuffers();
 }
 
 int main(int argc, char* argv[]) {
+    const auto headless = parseHeadlessOptions(argc, argv);
+    if (headless.enabled()) {
+        ilInit();
+        HeadlessContext context(800, 600, 4, 5, true);
+        initialise();
+        // Each frame steps as far as the window's 50 ms timer would
+        const auto succeeded = runHeadless(headless, context, [](int) {
+            step(0.05f);
+            renderFrame();
+        });
+        scene.reset();
+        return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     glutInit(&argc, argv);
     glutSetOption(GLUT_MULTISAMPLE, 8);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH | GLUT_MULTISAMPLE);
@@ -0,0 +1,1075 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <IL/il.h>
+
+#include <assimp/cimport.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "compressed_clip.h"
+#include "cooked_asset.h"
+#include "image_decode.h"
+#include "keyframes.h"
+#include "pose_cache.h"
+#include "retargeting.h"
+#include "scenes.h"
+#include "skinning.h"
+#include "thread_pool.h"
+
+struct BoneInfo {
+    aiMatrix4x4 offsetMatrix;
+    // Transformation of the bone's node when no channel animates it
+    aiMatrix4x4 localTransformation;
+    // Always lower than the bone's own index, -1 for the root
+    int parentIndex;
+};
+
+struct BoundingBox {
+    aiVector3D min{+1e10f};
+    aiVector3D max{-1e10f};
+
+    bool empty() const {
+        return min.x > max.x;
+    }
+
+    void add(const aiVector3D& point) {
+        min = aiVector3D(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+        max = aiVector3D(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+    }
+
+    void add(const BoundingBox& box) {
+        if (!box.empty()) {
+            add(box.min);
+            add(box.max);
+        }
+    }
+
+    // Smallest box holding this one after an affine transform, from its centre and half extents
+    BoundingBox transformed(const AffineMatrix& matrix) const {
+        if (empty()) {
+            return {};
+        }
+        const auto m = matrix.m;
+        const auto centre = (min + max) * 0.5f;
+        const auto half = (max - min) * 0.5f;
+        const aiVector3D newCentre(m[0] * centre.x + m[1] * centre.y + m[2] * centre.z + m[3],
+                                   m[4] * centre.x + m[5] * centre.y + m[6] * centre.z + m[7],
+                                   m[8] * centre.x + m[9] * centre.y + m[10] * centre.z + m[11]);
+        const aiVector3D newHalf(std::abs(m[0]) * half.x + std::abs(m[1]) * half.y + std::abs(m[2]) * half.z,
+                                 std::abs(m[4]) * half.x + std::abs(m[5]) * half.y + std::abs(m[6]) * half.z,
+                                 std::abs(m[8]) * half.x + std::abs(m[9]) * half.y + std::abs(m[10]) * half.z);
+        return {newCentre - newHalf, newCentre + newHalf};
+    }
+};
+
+struct ScenePositions {
+    aiVector3D min;
+    aiVector3D max;
+    aiVector3D center;
+    float scale;
+};
+
+// Bind pose vertex of the GPU skinning path with its packed bone influences, skinned by data/skinning.vert
+struct GpuSkinnedVertex {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+    uint16_t boneIndices[MAX_INFLUENCES];
+    uint16_t boneWeights[MAX_INFLUENCES];
+    float colour[4];
+};
+
+// Attributes that never change, used by the CPU skinning path
+struct StaticVertex {
+    float texCoord[2];
+    float colour[4];
+};
+
+// Bind pose vertices and indices of one mesh, pointing into either the imported scene or a cooked file
+struct MeshData {
+    unsigned int materialIndex;
+    unsigned int vertexCount;
+    const aiVector3D* positions;
+    // Null when the mesh has none
+    const aiVector3D* normals;
+    const aiVector3D* texCoords;
+    const aiColor4D* colours;
+    // Padded to whole skinning blocks
+    const VertexWeights* weights;
+    // Points, then lines, then triangles
+    const unsigned int* indices;
+    unsigned int indexCounts[3];
+    // The vertices interleaved as each skinning path uploads them
+    const GpuSkinnedVertex* gpuVertices;
+    const StaticVertex* staticVertices;
+};
+
+// Interleaves the bind pose attributes of a mesh into the vertex layouts of both skinning paths, zero where the mesh
+// has no normals, texture coordinates or colours
+inline void interleaveVertices(const MeshData& mesh, std::vector<GpuSkinnedVertex>& gpuVertices,
+                               std::vector<StaticVertex>& staticVertices) {
+    gpuVertices.assign(mesh.vertexCount, GpuSkinnedVertex{});
+    staticVertices.assign(mesh.vertexCount, StaticVertex{});
+    for (auto v = 0u; v < mesh.vertexCount; v++) {
+        auto& vertex = gpuVertices[v];
+        vertex.position[0] = mesh.positions[v].x;
+        vertex.position[1] = mesh.positions[v].y;
+        vertex.position[2] = mesh.positions[v].z;
+        if (mesh.normals) {
+            vertex.normal[0] = mesh.normals[v].x;
+            vertex.normal[1] = mesh.normals[v].y;
+            vertex.normal[2] = mesh.normals[v].z;
+        }
+        if (mesh.texCoords) {
+            vertex.texCoord[0] = mesh.texCoords[v].x;
+            vertex.texCoord[1] = mesh.texCoords[v].y;
+        }
+        if (mesh.colours) {
+            vertex.colour[0] = mesh.colours[v].r;
+            vertex.colour[1] = mesh.colours[v].g;
+            vertex.colour[2] = mesh.colours[v].b;
+            vertex.colour[3] = mesh.colours[v].a;
+        }
+        std::copy(mesh.weights[v].bones, mesh.weights[v].bones + MAX_INFLUENCES, vertex.boneIndices);
+        std::copy(mesh.weights[v].weights, mesh.weights[v].weights + MAX_INFLUENCES, vertex.boneWeights);
+
+        std::copy(vertex.texCoord, vertex.texCoord + 2, staticVertices[v].texCoord);
+        std::copy(vertex.colour, vertex.colour + 4, staticVertices[v].colour);
+    }
+}
+
+struct MaterialData {
+    bool hasDiffuse;
+    aiColor4D diffuse;
+    // Diffuse texture as named by the model, empty for none
+    std::string texture;
+};
+
+struct SkinnedMesh {
+    SkinningInput input;
+    SkinningOutput output;
+};
+
+// Texture stored inside the model file, either compressed in a format given by its hint or as raw texels
+struct EmbeddedTexture {
+    std::string fileName;
+    std::string formatHint;
+    // Zero height means data holds width bytes of a compressed image, otherwise width * height BGRA texels
+    unsigned int width;
+    unsigned int height;
+    const unsigned char* data;
+};
+
+// RGBA pixels of a diffuse texture, bottom row first, ready to upload
+struct DecodedTexture {
+    std::string fileName;
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+// Everything needed to animate one character, built without touching GL so it can be loaded on any thread
+class Character {
+public:
+    Character() = default;
+    Character(const Character&) = delete;
+    Character& operator=(const Character&) = delete;
+
+    ~Character() {
+        if (scene) {
+            aiReleaseImport(scene);
+        }
+        if (animationScene) {
+            aiReleaseImport(animationScene);
+        }
+    }
+
+    // Imports the model and, when given, a second file holding the animation it plays
+    void import(const std::string& modelFile, const std::string& animationFile) {
+        auto flags = aiProcessPreset_TargetRealtime_MaxQuality;
+        if (modelFile.compare(modelFile.size() - 4, 4, ".bvh") == 0) {
+            flags |= aiProcess_Debone;
+        }
+        scene = aiImportFile(modelFile.c_str(), flags);
+        if (scene == nullptr) {
+            throw std::exception{};
+        }
+
+        if (!animationFile.empty()) {
+            animationScene = aiImportFile(animationFile.c_str(), aiProcessPreset_TargetRealtime_MaxQuality);
+            if (animationScene == nullptr) {
+                throw std::exception{};
+            }
+        }
+    }
+
+    // Decodes the diffuse textures of every material on the pool, each distinct file or embedded texture once.
+    // Files are looked up by name in the given directory.
+    void decodeTextures(const std::string& path, ThreadPool& pool) {
+        const auto start = std::chrono::steady_clock::now();
+
+        // Materials naming the same file, or the same embedded texture, share one decode
+        std::vector<std::string> sources{};
+        std::vector<int> sourceEmbedded{};
+        std::unordered_map<std::string, int> sourceIndices{};
+        materialTextures.assign(materials.size(), -1);
+        for (auto m = 0u; m < materials.size(); m++) {
+            if (materials[m].texture.empty()) {
+                continue;
+            }
+
+            const auto embedded = findEmbeddedTexture(materials[m].texture);
+            const auto key = embedded >= 0 ? "*" + std::to_string(embedded)
+                                           : path + stripDirectory(materials[m].texture);
+            auto source = sourceIndices.find(key);
+            if (source == sourceIndices.end()) {
+                source = sourceIndices.emplace(key, sources.size()).first;
+                sources.push_back(key);
+                sourceEmbedded.push_back(embedded);
+            }
+            materialTextures[m] = source->second;
+        }
+
+        std::vector<DecodedTexture> decoded(sources.size());
+        pool.parallelFor(sources.size(), [&](int i) {
+            decoded[i].fileName = sources[i];
+            if (sourceEmbedded[i] >= 0) {
+                decodeEmbedded(embeddedTextures[sourceEmbedded[i]], decoded[i]);
+            } else {
+                decodeFile(sources[i], decoded[i]);
+            }
+        });
+
+        // Drop the textures that failed, leaving their materials untextured
+        std::vector<int> remap(decoded.size(), -1);
+        textures.clear();
+        for (auto i = 0u; i < decoded.size(); i++) {
+            if (decoded[i].pixels.empty()) {
+                std::cout << "Couldn't load Image: " << decoded[i].fileName << std::endl;
+                continue;
+            }
+            remap[i] = textures.size();
+            textures.push_back(std::move(decoded[i]));
+        }
+        for (auto& texture : materialTextures) {
+            texture = texture < 0 ? -1 : remap[texture];
+        }
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Decoded " << textures.size() << " textures for " << materials.size() << " materials in "
+                  << elapsed.count() << " ms" << std::endl;
+    }
+
+    // Imports the scene through Assimp and readies its skeleton, animation and meshes
+    void importScene(const SceneSource& source, double defaultTicksPerSecond) {
+        const auto start = std::chrono::steady_clock::now();
+        import(source.modelFile, source.animationFile);
+        if (source.mannequin) {
+            cleanupMannequin();
+        }
+        buildAnimation(source.retargeting, defaultTicksPerSecond);
+        buildMeshes();
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Imported " << source.modelFile << " in " << elapsed.count() << " ms" << std::endl;
+    }
+
+    // The mannequin's root nodes carry a scale the run clip doesn't expect, and its root motion is in centimetres
+    void cleanupMannequin() {
+        for (auto i = 0u; i < scene->mRootNode->mNumChildren; i++) {
+            scene->mRootNode->mChildren[i]->mTransformation = aiMatrix4x4();
+        }
+
+        for (auto i = 0u; i < animationScene->mAnimations[0]->mNumChannels; i++) {
+            auto channel = animationScene->mAnimations[0]->mChannels[i];
+            if (channel->mNodeName == aiString("free3dmodel_skeleton")) {
+                for (auto j = 0u; j < channel->mNumPositionKeys; j++) {
+                    channel->mPositionKeys[j].mValue = channel->mPositionKeys[j].mValue / 100.0f;
+                }
+            }
+        }
+    }
+
+    // Numbers the skeleton, packs the vertex weights and binds every channel of the animation to its bone. With a
+    // retargeting map the model's own animation is played with channels swapped in from the animation file.
+    void buildAnimation(const RetargetMap* retargeting, double defaultTicksPerSecond) {
+        bones.clear();
+        vertexWeights.clear();
+
+        const auto sourceScene = (animationScene && !retargeting) ? animationScene : scene;
+        if (!sourceScene->mAnimations) {
+            throw std::exception{};
+        }
+
+        animation = sourceScene->mAnimations[0];
+        if (std::round(animation->mDuration) != animation->mDuration) {
+            throw std::exception{};
+        }
+        duration = static_cast<int>(animation->mDuration);
+        ticksPerSecond = animation->mTicksPerSecond > 0 ? animation->mTicksPerSecond : defaultTicksPerSecond;
+
+        std::unordered_map<std::string, int> boneMapping{};
+        findBones(scene->mRootNode, -1, boneMapping);
+        for (auto i = 0u; i < scene->mNumMeshes; i++) {
+            for (auto j = 0u; j < scene->mMeshes[i]->mNumBones; j++) {
+                const auto& bone = scene->mMeshes[i]->mBones[j];
+                bones.at(boneMapping.at(bone->mName.C_Str())).offsetMatrix = bone->mOffsetMatrix;
+            }
+        }
+
+        vertexWeights.resize(scene->mNumMeshes);
+        auto maxWeightError = 0.0f;
+        auto prunedVertices = 0;
+        for (auto i = 0u; i < scene->mNumMeshes; i++) {
+            const auto mesh = scene->mMeshes[i];
+            std::vector<InfluenceAccumulator> influences(mesh->mNumVertices);
+            std::vector<int> influenceCounts(mesh->mNumVertices);
+
+            for (auto j = 0u; j < mesh->mNumBones; j++) {
+                const auto& bone = mesh->mBones[j];
+                const auto boneIndex = boneMapping.find(bone->mName.C_Str())->second;
+                for (auto k = 0u; k < bone->mNumWeights; k++) {
+                    const auto& weight = bone->mWeights[k];
+                    influences[weight.mVertexId].add(boneIndex, weight.mWeight);
+                    influenceCounts[weight.mVertexId]++;
+                }
+            }
+
+            auto& meshVertexWeights = vertexWeights.at(i);
+            meshVertexWeights.assign(paddedVertexCount(mesh->mNumVertices), VertexWeights{});
+            for (auto v = 0u; v < mesh->mNumVertices; v++) {
+                maxWeightError = std::max(maxWeightError, influences[v].pack(meshVertexWeights[v]));
+                if (influenceCounts[v] > MAX_INFLUENCES) {
+                    prunedVertices++;
+                }
+            }
+        }
+        std::cout << "Vertex weights: " << prunedVertices << " vertices pruned to " << MAX_INFLUENCES
+                  << " influences, max weight error " << maxWeightError << std::endl;
+
+        const auto sourceAnimation =
+                (animationScene && animationScene->mAnimations) ? animationScene->mAnimations[0] : nullptr;
+        channelBindings = compileBindings(animation, sourceAnimation, retargeting, boneMapping);
+        compressed = false;
+    }
+
+    // Points the mesh data at the imported scene, gathering each mesh's faces into one index array and interleaving
+    // its vertices for upload
+    void buildMeshes() {
+        meshes.clear();
+        meshIndices.clear();
+        meshIndices.resize(scene->mNumMeshes);
+        meshGpuVertices.clear();
+        meshGpuVertices.resize(scene->mNumMeshes);
+        meshStaticVertices.clear();
+        meshStaticVertices.resize(scene->mNumMeshes);
+        for (auto i = 0u; i < scene->mNumMeshes; i++) {
+            const auto mesh = scene->mMeshes[i];
+            std::vector<unsigned int> indices[3]{};
+            for (auto k = 0u; k < mesh->mNumFaces; k++) {
+                const auto& face = mesh->mFaces[k];
+                if (face.mNumIndices >= 1 && face.mNumIndices <= 3) {
+                    indices[face.mNumIndices - 1].insert(indices[face.mNumIndices - 1].end(), face.mIndices,
+                                                         face.mIndices + face.mNumIndices);
+                }
+            }
+
+            MeshData data{mesh->mMaterialIndex, mesh->mNumVertices, mesh->mVertices,
+                          mesh->HasNormals() ? mesh->mNormals : nullptr,
+                          mesh->HasTextureCoords(0) ? mesh->mTextureCoords[0] : nullptr,
+                          mesh->HasVertexColors(0) ? mesh->mColors[0] : nullptr,
+                          vertexWeights.at(i).data(), nullptr, {}};
+            for (auto k = 0; k < 3; k++) {
+                data.indexCounts[k] = indices[k].size();
+                meshIndices[i].insert(meshIndices[i].end(), indices[k].begin(), indices[k].end());
+            }
+            data.indices = meshIndices[i].data();
+            interleaveVertices(data, meshGpuVertices[i], meshStaticVertices[i]);
+            data.gpuVertices = meshGpuVertices[i].data();
+            data.staticVertices = meshStaticVertices[i].data();
+            meshes.push_back(data);
+        }
+
+        materials.clear();
+        for (auto m = 0u; m < scene->mNumMaterials; m++) {
+            MaterialData material{false, aiColor4D(), ""};
+            material.hasDiffuse =
+                    aiGetMaterialColor(scene->mMaterials[m], AI_MATKEY_COLOR_DIFFUSE, &material.diffuse) == AI_SUCCESS;
+            aiString fileName;
+            if (scene->mMaterials[m]->GetTexture(aiTextureType_DIFFUSE, 0, &fileName) == AI_SUCCESS) {
+                material.texture = fileName.C_Str();
+            }
+            materials.push_back(material);
+        }
+
+        embeddedTextures.clear();
+        for (auto t = 0u; t < scene->mNumTextures; t++) {
+            const auto texture = scene->mTextures[t];
+            embeddedTextures.push_back({texture->mFilename.C_Str(), texture->achFormatHint, texture->mWidth,
+                                        texture->mHeight, reinterpret_cast<const unsigned char*>(texture->pcData)});
+        }
+    }
+
+    // Maps the scene's cooked file, pointing the meshes, channels, baked poses and embedded textures straight into it.
+    // Returns false, leaving the character untouched, when there is no cooked file or it is out of date with the
+    // scene's sources, and throws if the file is truncated or corrupt.
+    bool loadCooked(const SceneSource& source, double defaultTicksPerSecond) {
+        const auto start = std::chrono::steady_clock::now();
+        const auto fileName = source.cookedFile();
+        if (fileStamp(fileName).size == 0) {
+            std::cout << "No cooked file " << fileName << ", importing " << source.modelFile << std::endl;
+            return false;
+        }
+
+        auto mapped = std::make_unique<MappedFile>(fileName);
+        const auto& header = *mapped->at<CookedHeader>(0, 1);
+        const auto model = fileStamp(source.modelFile);
+        const auto animationStamp = fileStamp(source.animationFile);
+        // Sources that are missing leave the cooked file as the only copy, which is fine
+        if (std::memcmp(header.magic, cookedMagic, sizeof(cookedMagic)) != 0 || header.version != cookedVersion ||
+            header.maxInfluences != MAX_INFLUENCES || (model.size != 0 && !(model == header.model)) ||
+            (animationStamp.size != 0 && !(animationStamp == header.animation))) {
+            std::cout << "Cooked file " << fileName << " is stale, importing " << source.modelFile << std::endl;
+            return false;
+        }
+
+        const auto cookedMeshes = mapped->at<CookedMesh>(header.meshes, header.meshCount);
+        meshes.clear();
+        for (auto i = 0u; i < header.meshCount; i++) {
+            const auto& mesh = cookedMeshes[i];
+            const auto indexCount = mesh.indexCounts[0] + mesh.indexCounts[1] + mesh.indexCounts[2];
+            meshes.push_back({mesh.materialIndex, mesh.vertexCount,
+                              mapped->at<aiVector3D>(mesh.positions, mesh.vertexCount),
+                              mesh.hasNormals ? mapped->at<aiVector3D>(mesh.normals, mesh.vertexCount) : nullptr,
+                              mesh.hasTexCoords ? mapped->at<aiVector3D>(mesh.texCoords, mesh.vertexCount) : nullptr,
+                              mesh.hasColours ? mapped->at<aiColor4D>(mesh.colours, mesh.vertexCount) : nullptr,
+                              mapped->at<VertexWeights>(mesh.weights, paddedVertexCount(mesh.vertexCount)),
+                              mapped->at<unsigned int>(mesh.indices, indexCount),
+                              {mesh.indexCounts[0], mesh.indexCounts[1], mesh.indexCounts[2]},
+                              mapped->at<GpuSkinnedVertex>(mesh.gpuVertices, mesh.vertexCount),
+                              mapped->at<StaticVertex>(mesh.staticVertices, mesh.vertexCount)});
+        }
+
+        const auto cookedMaterials = mapped->at<CookedMaterial>(header.materials, header.materialCount);
+        materials.clear();
+        for (auto m = 0u; m < header.materialCount; m++) {
+            const auto& material = cookedMaterials[m];
+            materials.push_back({material.hasDiffuse != 0, material.diffuse,
+                                 std::string(material.texture, strnlen(material.texture, sizeof(material.texture)))});
+        }
+
+        const auto cookedTextures = mapped->at<CookedTexture>(header.textures, header.textureCount);
+        embeddedTextures.clear();
+        for (auto t = 0u; t < header.textureCount; t++) {
+            const auto& texture = cookedTextures[t];
+            const auto size = texture.height == 0 ? std::size_t(texture.width)
+                                                  : std::size_t(texture.width) * texture.height * 4;
+            embeddedTextures.push_back({std::string(texture.fileName, strnlen(texture.fileName, sizeof(texture.fileName))),
+                                        std::string(texture.formatHint,
+                                                    strnlen(texture.formatHint, sizeof(texture.formatHint))),
+                                        texture.width, texture.height, mapped->at<unsigned char>(texture.data, size)});
+        }
+
+        const auto cookedBones = mapped->at<CookedBone>(header.bones, header.boneCount);
+        bones.clear();
+        for (auto b = 0u; b < header.boneCount; b++) {
+            if (cookedBones[b].parentIndex >= static_cast<int>(b)) {
+                throw std::exception{};
+            }
+            bones.push_back({cookedBones[b].offsetMatrix, cookedBones[b].localTransformation,
+                             cookedBones[b].parentIndex});
+        }
+
+        const auto cookedChannels = mapped->at<CookedChannel>(header.channels, header.channelCount);
+        mappedChannels.clear();
+        channelBindings.clear();
+        for (auto i = 0u; i < header.channelCount; i++) {
+            const auto& cooked = cookedChannels[i];
+            if (cooked.bone < 0 || cooked.bone >= static_cast<int>(header.boneCount)) {
+                throw std::exception{};
+            }
+
+            // Assimp never writes through the key pointers, so they can point at the read only mapping
+            MappedChannel channel{new aiNodeAnim()};
+            channel->mNodeName = aiString(std::string(cooked.name, strnlen(cooked.name, sizeof(cooked.name))));
+            channel->mNumPositionKeys = cooked.positionCount;
+            channel->mPositionKeys =
+                    const_cast<aiVectorKey*>(mapped->at<aiVectorKey>(cooked.positionKeys, cooked.positionCount));
+            channel->mNumRotationKeys = cooked.rotationCount;
+            channel->mRotationKeys =
+                    const_cast<aiQuatKey*>(mapped->at<aiQuatKey>(cooked.rotationKeys, cooked.rotationCount));
+            channel->mNumScalingKeys = cooked.scalingCount;
+            channel->mScalingKeys =
+                    const_cast<aiVectorKey*>(mapped->at<aiVectorKey>(cooked.scalingKeys, cooked.scalingCount));
+
+            channelBindings.push_back({channel.get(), cooked.bone, cooked.timeScale, cooked.frozen != 0,
+                                       cooked.retargeted != 0, cooked.correction, {}, {}});
+            mappedChannels.push_back(std::move(channel));
+        }
+
+        cookedPoses = mapped->at<AffineMatrix>(header.poses, std::size_t(header.duration) * header.boneCount);
+
+        duration = header.duration;
+        ticksPerSecond = header.ticksPerSecond > 0 ? header.ticksPerSecond : defaultTicksPerSecond;
+        positions = {header.boundsMin, header.boundsMax, header.boundsCenter, header.boundsScale};
+        vertexWeights.clear();
+        meshIndices.clear();
+        meshGpuVertices.clear();
+        meshStaticVertices.clear();
+        compressed = false;
+        cooked = std::move(mapped);
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Loaded cooked " << fileName << " (" << cooked->size() / (1024.0 * 1024.0) << " MB) in "
+                  << elapsed.count() << " ms" << std::endl;
+        return true;
+    }
+
+    // Writes everything loadCooked reads, after importScene, bake and computeBounds
+    void writeCooked(const SceneSource& source) {
+        CookedWriter writer{};
+        CookedHeader header{};
+        std::memcpy(header.magic, cookedMagic, sizeof(cookedMagic));
+        header.version = cookedVersion;
+        header.maxInfluences = MAX_INFLUENCES;
+        header.model = fileStamp(source.modelFile);
+        header.animation = fileStamp(source.animationFile);
+        header.duration = duration;
+        header.ticksPerSecond = animation->mTicksPerSecond;
+        header.boundsMin = positions.min;
+        header.boundsMax = positions.max;
+        header.boundsCenter = positions.center;
+        header.boundsScale = positions.scale;
+
+        std::vector<CookedMesh> cookedMeshes{};
+        for (const auto& mesh : meshes) {
+            CookedMesh cookedMesh{};
+            cookedMesh.materialIndex = mesh.materialIndex;
+            cookedMesh.vertexCount = mesh.vertexCount;
+            std::copy(mesh.indexCounts, mesh.indexCounts + 3, cookedMesh.indexCounts);
+            cookedMesh.hasNormals = mesh.normals != nullptr;
+            cookedMesh.hasTexCoords = mesh.texCoords != nullptr;
+            cookedMesh.hasColours = mesh.colours != nullptr;
+            cookedMesh.positions = writer.append(mesh.positions, mesh.vertexCount);
+            cookedMesh.normals = writer.append(mesh.normals, mesh.normals ? mesh.vertexCount : 0);
+            cookedMesh.texCoords = writer.append(mesh.texCoords, mesh.texCoords ? mesh.vertexCount : 0);
+            cookedMesh.colours = writer.append(mesh.colours, mesh.colours ? mesh.vertexCount : 0);
+            cookedMesh.indices = writer.append(mesh.indices,
+                                               mesh.indexCounts[0] + mesh.indexCounts[1] + mesh.indexCounts[2]);
+            cookedMesh.weights = writer.append(mesh.weights, paddedVertexCount(mesh.vertexCount));
+            cookedMesh.gpuVertices = writer.append(mesh.gpuVertices, mesh.vertexCount);
+            cookedMesh.staticVertices = writer.append(mesh.staticVertices, mesh.vertexCount);
+            cookedMeshes.push_back(cookedMesh);
+        }
+
+        std::vector<CookedMaterial> cookedMaterials{};
+        for (const auto& material : materials) {
+            CookedMaterial cookedMaterial{};
+            cookedMaterial.diffuse = material.diffuse;
+            cookedMaterial.hasDiffuse = material.hasDiffuse;
+            if (material.texture.size() >= sizeof(cookedMaterial.texture)) {
+                throw std::exception{};
+            }
+            std::copy(material.texture.begin(), material.texture.end(), cookedMaterial.texture);
+            cookedMaterials.push_back(cookedMaterial);
+        }
+
+        std::vector<CookedTexture> cookedTextures{};
+        for (const auto& texture : embeddedTextures) {
+            CookedTexture cookedTexture{};
+            if (texture.fileName.size() >= sizeof(cookedTexture.fileName) ||
+                texture.formatHint.size() >= sizeof(cookedTexture.formatHint)) {
+                throw std::exception{};
+            }
+            std::copy(texture.fileName.begin(), texture.fileName.end(), cookedTexture.fileName);
+            std::copy(texture.formatHint.begin(), texture.formatHint.end(), cookedTexture.formatHint);
+            cookedTexture.width = texture.width;
+            cookedTexture.height = texture.height;
+            cookedTexture.data = writer.append(texture.data, texture.height == 0
+                                                             ? std::size_t(texture.width)
+                                                             : std::size_t(texture.width) * texture.height * 4);
+            cookedTextures.push_back(cookedTexture);
+        }
+
+        std::vector<CookedBone> cookedBones{};
+        for (const auto& bone : bones) {
+            cookedBones.push_back({bone.offsetMatrix, bone.localTransformation, bone.parentIndex});
+        }
+
+        std::vector<CookedChannel> cookedChannels{};
+        for (const auto& binding : channelBindings) {
+            const auto channel = binding.source;
+            CookedChannel cookedChannel{};
+            std::strncpy(cookedChannel.name, channel->mNodeName.C_Str(), sizeof(cookedChannel.name) - 1);
+            cookedChannel.bone = binding.bone;
+            cookedChannel.frozen = binding.frozen;
+            cookedChannel.retargeted = binding.retargeted;
+            cookedChannel.timeScale = binding.timeScale;
+            cookedChannel.correction = binding.correction;
+            cookedChannel.positionCount = channel->mNumPositionKeys;
+            cookedChannel.rotationCount = channel->mNumRotationKeys;
+            cookedChannel.scalingCount = channel->mNumScalingKeys;
+            cookedChannel.positionKeys = writer.append(channel->mPositionKeys, channel->mNumPositionKeys);
+            cookedChannel.rotationKeys = writer.append(channel->mRotationKeys, channel->mNumRotationKeys);
+            cookedChannel.scalingKeys = writer.append(channel->mScalingKeys, channel->mNumScalingKeys);
+            cookedChannels.push_back(cookedChannel);
+        }
+
+        std::vector<AffineMatrix> poses{};
+        poses.reserve(std::size_t(duration) * bones.size());
+        for (auto tick = 0; tick < duration; tick++) {
+            const auto pose = poseCache.get(tick);
+            poses.insert(poses.end(), pose, pose + bones.size());
+        }
+
+        header.meshCount = cookedMeshes.size();
+        header.materialCount = cookedMaterials.size();
+        header.textureCount = cookedTextures.size();
+        header.boneCount = cookedBones.size();
+        header.channelCount = cookedChannels.size();
+        header.meshes = writer.append(cookedMeshes.data(), cookedMeshes.size());
+        header.materials = writer.append(cookedMaterials.data(), cookedMaterials.size());
+        header.textures = writer.append(cookedTextures.data(), cookedTextures.size());
+        header.bones = writer.append(cookedBones.data(), cookedBones.size());
+        header.channels = writer.append(cookedChannels.data(), cookedChannels.size());
+        header.poses = writer.append(poses.data(), poses.size());
+        writer.write(source.cookedFile(), header);
+    }
+
+    // Quantizes and reduces the keys of every channel binding, then reports how much smaller the clip is and the
+    // furthest any joint moves from where the uncompressed keys put it
+    void compress(const ClipTolerance& tolerance, ThreadPool& pool) {
+        pool.parallelFor(channelBindings.size(), [this, &tolerance](int i) {
+            auto& binding = channelBindings[i];
+            binding.compressed.build(binding.source, duration * binding.timeScale, tolerance);
+        });
+
+        std::size_t rawBytes = 0;
+        std::size_t compressedBytes = 0;
+        for (const auto& binding : channelBindings) {
+            rawBytes += CompressedChannel::rawBytes(binding.source);
+            compressedBytes += binding.compressed.bytes();
+        }
+
+        std::vector<KeyframeCursor> rawCursors(channelBindings.size());
+        std::vector<KeyframeCursor> compressedCursors(channelBindings.size());
+        std::vector<aiMatrix4x4> rawLocals{};
+        std::vector<aiMatrix4x4> compressedLocals{};
+        std::vector<aiMatrix4x4> rawGlobals{};
+        std::vector<aiMatrix4x4> compressedGlobals{};
+        auto maxError = 0.0f;
+        for (auto tick = 0; tick < duration; tick++) {
+            rawLocals.resize(bones.size());
+            compressedLocals.resize(bones.size());
+            for (auto b = 0u; b < bones.size(); b++) {
+                rawLocals[b] = bones[b].localTransformation;
+                compressedLocals[b] = bones[b].localTransformation;
+            }
+
+            for (auto i = 0u; i < channelBindings.size(); i++) {
+                const auto& binding = channelBindings[i];
+                rawLocals[binding.bone] = sampleBinding(binding, tick, rawCursors[i], false);
+                compressedLocals[binding.bone] = sampleBinding(binding, tick, compressedCursors[i], true);
+            }
+
+            computeGlobalTransforms(rawLocals, rawGlobals);
+            computeGlobalTransforms(compressedLocals, compressedGlobals);
+            for (auto b = 0u; b < bones.size(); b++) {
+                const auto& raw = rawGlobals[b];
+                const auto& compressedGlobal = compressedGlobals[b];
+                const auto error = aiVector3D(raw.a4 - compressedGlobal.a4, raw.b4 - compressedGlobal.b4,
+                                              raw.c4 - compressedGlobal.c4);
+                maxError = std::max(maxError, error.Length());
+            }
+        }
+
+        compressed = true;
+        std::cout << "Compressed clip: " << rawBytes / 1024.0 << " KB of keys to " << compressedBytes / 1024.0
+                  << " KB (" << (compressedBytes > 0 ? double(rawBytes) / compressedBytes : 0.0)
+                  << "x), max joint error " << maxError << std::endl;
+    }
+
+    // Bakes every tick, on the pool when one is given, or prepares to evaluate poses on demand within maxBytes.
+    // A cooked character reads the poses baked by the cooker straight from its file unless the clip has since been
+    // compressed.
+    void bake(bool bakeAll, std::size_t maxBytes, ThreadPool* pool) {
+        const auto start = std::chrono::steady_clock::now();
+        if (bakeAll && cookedPoses && !compressed) {
+            poseCache.map(duration, bones.size(), cookedPoses);
+            std::cout << "Animation mapped from the cooked file, "
+                      << std::size_t(duration) * bones.size() * sizeof(AffineMatrix) / (1024.0 * 1024.0) << " MB"
+                      << std::endl;
+            return;
+        }
+
+        PoseCache::Baker baker{};
+        if (pool) {
+            baker = [this, pool](std::vector<SkinningPose>& poses) { bakePoses(poses, *pool); };
+        }
+        poseCache.reset(duration, bones.size(), bakeAll, maxBytes,
+                        [this](int tick, SkinningPose& pose) { evaluatePose(tick, pose); }, baker);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (poseCache.isBaked()) {
+            std::cout << "Animation baked in " << elapsed.count() << " ms, "
+                      << poseCache.memoryUsed() / (1024.0 * 1024.0) << " MB" << std::endl;
+        } else {
+            std::cout << "Animation evaluated on demand, caching up to " << poseCache.getCapacity() << " poses"
+                      << std::endl;
+        }
+    }
+
+    // Copies the bind pose and weights of every mesh into the SoA layout used by the skinning kernel, and bounds the
+    // vertices of each bone
+    void buildSkinnedMeshes() {
+        skinnedMeshes.clear();
+        skinnedMeshes.resize(meshes.size());
+        for (auto i = 0u; i < meshes.size(); i++) {
+            const auto& mesh = meshes[i];
+            auto& input = skinnedMeshes[i].input;
+            input.resize(mesh.vertexCount, mesh.normals != nullptr);
+            input.weights = mesh.weights;
+            for (auto v = 0u; v < mesh.vertexCount; v++) {
+                input.positionX[v] = mesh.positions[v].x;
+                input.positionY[v] = mesh.positions[v].y;
+                input.positionZ[v] = mesh.positions[v].z;
+                if (input.hasNormals) {
+                    input.normalX[v] = mesh.normals[v].x;
+                    input.normalY[v] = mesh.normals[v].y;
+                    input.normalZ[v] = mesh.normals[v].z;
+                }
+            }
+
+            skinnedMeshes[i].output.resize(input);
+        }
+
+        palette.resize(bones.size());
+        skinnedTime = -1;
+
+        boneBounds.assign(bones.size(), BoundingBox{});
+        for (const auto& mesh : meshes) {
+            for (auto v = 0u; v < mesh.vertexCount; v++) {
+                for (auto k = 0; k < MAX_INFLUENCES; k++) {
+                    if (mesh.weights[v].weights[k] > 0) {
+                        boneBounds.at(mesh.weights[v].bones[k]).add(mesh.positions[v]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Checks every available kernel against the scalar reference and prints its throughput
+    void reportSkinning(SkinningPath path) {
+        skin(0, path, false);
+
+        auto vertexCount = 0;
+        for (const auto& skinnedMesh : skinnedMeshes) {
+            vertexCount += skinnedMesh.input.vertexCount;
+        }
+
+        for (auto testedPath : {SkinningPath::Scalar, SkinningPath::SSE, SkinningPath::AVX2}) {
+            if (!skinningPathSupported(testedPath)) {
+                continue;
+            }
+
+            auto error = 0.0f;
+            auto seconds = 0.0;
+            for (auto& skinnedMesh : skinnedMeshes) {
+                SkinningOutput reference{};
+                reference.resize(skinnedMesh.input);
+                skinVerticesScalar(palette, skinnedMesh.input, reference);
+
+                const auto verticesPerSecond =
+                        measureSkinning(testedPath, palette, skinnedMesh.input, skinnedMesh.output, 10);
+                if (verticesPerSecond > 0) {
+                    seconds += skinnedMesh.input.vertexCount / verticesPerSecond;
+                }
+                error = std::max(error, skinningError(skinnedMesh.input, skinnedMesh.output, reference));
+            }
+
+            std::cout << "Skinning (" << skinningPathName(testedPath) << "): " << vertexCount << " vertices, "
+                      << (seconds > 0 ? vertexCount / seconds : 0.0) << " vertices/second, max error " << error
+                      << std::endl;
+        }
+
+        skinnedTime = -1;
+    }
+
+    // Bounds of the first frame, with the scale and centre that fit it into the view
+    void computeBounds() {
+        const auto bounds = poseBounds(poseCache.get(0));
+        positions.min = bounds.min;
+        positions.max = bounds.max;
+
+        auto size = positions.max.x - positions.min.x;
+        size = std::max(positions.max.y - positions.min.y, size);
+        size = std::max(positions.max.z - positions.min.z, size);
+        positions.scale = 1.0f / size;
+        positions.center = ((positions.max - positions.min) * 0.5f + positions.min) * positions.scale;
+    }
+
+    // Bounds of the character in a pose, the union of every bone's box carried by its skinning matrix. Each skinned
+    // vertex is a weighted average of its bones' transforms of it, so it lies inside this box. O(bones).
+    BoundingBox poseBounds(const AffineMatrix* pose) const {
+        BoundingBox bounds{};
+        for (auto b = 0u; b < boneBounds.size(); b++) {
+            bounds.add(boneBounds[b].transformed(pose[b]));
+        }
+        return bounds;
+    }
+
+    // Skinning matrices at the given time in ticks, sampled straight from the keys
+    void evaluatePose(double time, SkinningPose& pose) {
+        std::vector<aiMatrix4x4> locals(bones.size());
+        for (auto i = 0u; i < bones.size(); i++) {
+            locals[i] = bones[i].localTransformation;
+        }
+        for (auto& binding : channelBindings) {
+            locals.at(binding.bone) = sampleBinding(binding, time, binding.cursor, compressed);
+        }
+        composePose(locals, pose);
+    }
+
+    // Fills the palette for a time in ticks, either from the keys directly or blended between the two nearest poses
+    void updatePalette(double time, bool direct) {
+        sampledPose.resize(bones.size());
+        if (direct) {
+            evaluatePose(time, sampledPose);
+        } else {
+            const auto tick = static_cast<int>(time);
+            const auto factor = static_cast<float>(time - tick);
+            const auto pose = poseCache.get(tick);
+            std::copy(pose, pose + bones.size(), sampledPose.matrix.begin());
+            if (factor > 0) {
+                blendPose(sampledPose, poseCache.get((tick + 1) % duration), factor);
+            }
+        }
+
+        for (auto i = 0u; i < bones.size(); i++) {
+            palette.setBone(i, sampledPose.matrix[i].m);
+        }
+        frameBounds = poseBounds(sampledPose.matrix.data());
+    }
+
+    // Skins every mesh for the given time, returning false when the meshes already hold that time
+    bool skin(double time, SkinningPath path, bool direct) {
+        if (time == skinnedTime) {
+            return false;
+        }
+
+        updatePalette(time, direct);
+        for (auto& skinnedMesh : skinnedMeshes) {
+            skinVertices(path, palette, skinnedMesh.input, skinnedMesh.output);
+        }
+        skinnedTime = time;
+        return true;
+    }
+
+    const aiScene* scene{};
+    const aiScene* animationScene{};
+    const aiAnimation* animation{};
+    int duration{};
+    double ticksPerSecond{};
+
+    std::vector<MeshData> meshes{};
+    std::vector<MaterialData> materials{};
+
+    std::vector<BoneInfo> bones{};
+    // One flat array per mesh, padded to whole skinning blocks
+    std::vector<AlignedVector<VertexWeights>> vertexWeights{};
+    std::vector<ChannelBinding> channelBindings{};
+    bool compressed{};
+    PoseCache poseCache{};
+
+    std::vector<SkinnedMesh> skinnedMeshes{};
+    SkinningPalette palette{};
+    SkinningPose sampledPose{};
+    double skinnedTime{-1};
+
+    ScenePositions positions{};
+    // Bind pose box of the vertices each bone influences
+    std::vector<BoundingBox> boneBounds{};
+    // Bounds of the pose last put in the palette
+    BoundingBox frameBounds{};
+    std::vector<EmbeddedTexture> embeddedTextures{};
+    // Index into textures of each material's diffuse texture, -1 for none
+    std::vector<int> materialTextures{};
+    std::vector<DecodedTexture> textures{};
+
+private:
+    // Index arrays and interleaved vertices the imported meshes point into
+    std::vector<std::vector<unsigned int>> meshIndices{};
+    std::vector<std::vector<GpuSkinnedVertex>> meshGpuVertices{};
+    std::vector<std::vector<StaticVertex>> meshStaticVertices{};
+    // Cooked file the meshes, channels, poses and embedded textures point into, when the character was loaded from one
+    std::unique_ptr<MappedFile> cooked{};
+    std::vector<MappedChannel> mappedChannels{};
+    const AffineMatrix* cookedPoses{};
+
+    // Numbers every node depth first, so a bone's parent always has a lower index than the bone itself
+    void findBones(const aiNode* node, int parentIndex, std::unordered_map<std::string, int>& boneMapping) {
+        auto mapping = boneMapping.find(node->mName.C_Str());
+        if (mapping == boneMapping.end()) {
+            mapping = boneMapping.insert(std::make_pair(node->mName.C_Str(), bones.size())).first;
+            bones.push_back({aiMatrix4x4(), node->mTransformation, parentIndex});
+        }
+
+        for (auto i = 0u; i < node->mNumChildren; i++) {
+            findBones(node->mChildren[i], mapping->second, boneMapping);
+        }
+    }
+
+    // Global transform of every bone from its local one, in a single pass as parents come before children
+    void computeGlobalTransforms(const std::vector<aiMatrix4x4>& locals, std::vector<aiMatrix4x4>& globals) const {
+        globals.resize(bones.size());
+        for (auto i = 0u; i < bones.size(); i++) {
+            const auto parent = bones[i].parentIndex;
+            globals[i] = parent < 0 ? locals[i] : globals[parent] * locals[i];
+        }
+    }
+
+    void composePose(const std::vector<aiMatrix4x4>& locals, SkinningPose& pose) const {
+        std::vector<aiMatrix4x4> globals{};
+        computeGlobalTransforms(locals, globals);
+
+        for (auto b = 0u; b < bones.size(); b++) {
+            pose.matrix[b] = AffineMatrix(globals[b] * bones[b].offsetMatrix);
+        }
+    }
+
+    // Bakes every tick in two phases: keys are sampled per bone, so each bone's cursor walks forward through its own
+    // keys, then global transforms are composed per tick. Every task writes only its own outputs, so the poses are
+    // identical to calling evaluatePose for each tick in turn.
+    void bakePoses(std::vector<SkinningPose>& poses, ThreadPool& pool) {
+        const auto tickCount = static_cast<int>(poses.size());
+        const auto boneCount = static_cast<int>(bones.size());
+
+        // Channel driving each bone, the last one wins as in evaluatePose
+        std::vector<int> boneBindings(boneCount, -1);
+        for (auto i = 0u; i < channelBindings.size(); i++) {
+            boneBindings.at(channelBindings[i].bone) = i;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::vector<aiMatrix4x4>> locals(tickCount, std::vector<aiMatrix4x4>(boneCount));
+        pool.parallelFor(boneCount, [&](int bone) {
+            KeyframeCursor cursor{};
+            for (auto tick = 0; tick < tickCount; tick++) {
+                locals[tick][bone] = boneBindings[bone] < 0
+                                     ? bones[bone].localTransformation
+                                     : sampleBinding(channelBindings[boneBindings[bone]], tick, cursor, compressed);
+            }
+        });
+        const auto sampled = std::chrono::steady_clock::now();
+
+        pool.parallelFor(tickCount, [&](int tick) {
+            composePose(locals[tick], poses[tick]);
+        });
+        const auto composed = std::chrono::steady_clock::now();
+
+        const std::chrono::duration<double, std::milli> sampleTime = sampled - start;
+        const std::chrono::duration<double, std::milli> composeTime = composed - sampled;
+        std::cout << "Bake on " << pool.size() + 1 << " threads: sampling keys " << sampleTime.count()
+                  << " ms, composing transforms " << composeTime.count() << " ms" << std::endl;
+    }
+
+    // Index of the embedded texture a material names, either as "*index" or by the embedded file's name, or -1
+    int findEmbeddedTexture(const std::string& name) const {
+        if (name.size() > 1 && name[0] == '*') {
+            const auto index = std::atoi(name.c_str() + 1);
+            return index >= 0 && index < static_cast<int>(embeddedTextures.size()) ? index : -1;
+        }
+        for (auto i = 0u; i < embeddedTextures.size(); i++) {
+            if (!embeddedTextures[i].fileName.empty() &&
+                stripDirectory(embeddedTextures[i].fileName) == stripDirectory(name)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // DevIL decodes into a single global current image, so only one thread may use it at a time
+    static std::mutex& devilMutex() {
+        static std::mutex mutex{};
+        return mutex;
+    }
+
+    // Decodes an image held in memory. PNG, JPEG and BMP decode on the calling thread with no lock held; anything
+    // else falls back to DevIL, its format guessed from the extension of fileName or else from its contents, one
+    // image at a time. Leaves pixels empty on failure.
+    static void decodeImage(const void* data, std::size_t size, const std::string& fileName, DecodedTexture& texture) {
+        if (decodeImageReentrant(data, size, texture.width, texture.height, texture.pixels)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{devilMutex()};
+        ILuint imageId;
+        ilGenImages(1, &imageId);
+        ilBindImage(imageId);
+        ilEnable(IL_ORIGIN_SET);
+        ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
+
+        if (ilLoadL(ilTypeFromExt(fileName.c_str()), data, static_cast<ILuint>(size))) {
+            ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+            texture.width = ilGetInteger(IL_IMAGE_WIDTH);
+            texture.height = ilGetInteger(IL_IMAGE_HEIGHT);
+            const auto pixels = ilGetData();
+            texture.pixels.assign(pixels, pixels + texture.width * texture.height * 4);
+        }
+        ilDeleteImages(1, &imageId);
+    }
+
+    // Reads the whole file and decodes it from memory
+    static void decodeFile(const std::string& fileName, DecodedTexture& texture) {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return;
+        }
+        std::vector<char> bytes(static_cast<std::size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(bytes.data(), bytes.size())) {
+            return;
+        }
+        decodeImage(bytes.data(), bytes.size(), fileName, texture);
+    }
+
+    static void decodeEmbedded(const EmbeddedTexture& embedded, DecodedTexture& texture) {
+        if (embedded.height == 0) {
+            decodeImage(embedded.data, embedded.width, "embedded." + embedded.formatHint, texture);
+            return;
+        }
+
+        // Raw texels are BGRA with the top row first
+        texture.width = embedded.width;
+        texture.height = embedded.height;
+        texture.pixels.resize(std::size_t(embedded.width) * embedded.height * 4);
+        for (auto y = 0u; y < embedded.height; y++) {
+            const auto source = embedded.data + std::size_t(embedded.height - 1 - y) * embedded.width * 4;
+            const auto target = texture.pixels.data() + std::size_t(y) * embedded.width * 4;
+            for (auto x = 0u; x < embedded.width; x++) {
+                target[x * 4] = source[x * 4 + 2];
+                target[x * 4 + 1] = source[x * 4 + 1];
+                target[x * 4 + 2] = source[x * 4];
+                target[x * 4 + 3] = source[x * 4 + 3];
+            }
+        }
+    }
+
+    static std::string stripDirectory(const std::string& fileName) {
+        const auto lastIndex = fileName.find_last_of("/\\");
+        return lastIndex == std::string::npos ? fileName : fileName.substr(lastIndex + 1);
+    }
+};
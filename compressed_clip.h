@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <assimp/scene.h>
+
+#include "keyframes.h"
+
+// Largest error keyframe reduction may introduce, rotation in radians and the others as a fraction of how far the
+// track moves
+struct ClipTolerance {
+    float rotation{0.001f};
+    float position{0.001f};
+    float scaling{0.001f};
+};
+
+// Key times quantized to 16 bits over the length of the animation
+struct QuantizedTimes {
+    std::vector<uint16_t> times{};
+    double scale{1};
+
+    void reset(double duration) {
+        times.clear();
+        scale = duration > 0 ? duration / 65535.0 : 1.0;
+    }
+
+    void push(double time) {
+        times.push_back(static_cast<uint16_t>(std::lround(std::min(std::max(time / scale, 0.0), 65535.0))));
+    }
+
+    double at(unsigned int index) const {
+        return times[index] * scale;
+    }
+
+    // Same search as findKey, over the quantized times
+    unsigned int find(double time, unsigned int& cursor) const {
+        const auto count = static_cast<unsigned int>(times.size());
+        const auto quantized = time / scale;
+        if (cursor + 1 < count && times[cursor] <= quantized) {
+            if (quantized < times[cursor + 1]) {
+                return cursor;
+            }
+            if (cursor + 2 < count && quantized < times[cursor + 2]) {
+                return ++cursor;
+            }
+        }
+
+        const auto upper = std::upper_bound(times.begin(), times.end(), quantized, [](double t, uint16_t key) {
+            return t < key;
+        });
+        const auto index = upper == times.begin() ? 0u : static_cast<unsigned int>(upper - times.begin() - 1);
+        cursor = std::min(index, count - 2);
+        return cursor;
+    }
+
+    double factor(unsigned int index, double time) const {
+        const auto length = at(index + 1) - at(index);
+        if (length <= 0) {
+            return time < at(index) ? 0.0 : 1.0;
+        }
+        return std::min(std::max((time - at(index)) / length, 0.0), 1.0);
+    }
+
+    std::size_t bytes() const {
+        return times.size() * sizeof(uint16_t) + sizeof(scale);
+    }
+};
+
+// Fraction of the way from keys[first] to keys[last] at the time of keys[key]
+template <typename Key>
+float keyFraction(const Key* keys, unsigned int first, unsigned int last, unsigned int key) {
+    const auto length = keys[last].mTime - keys[first].mTime;
+    return length > 0 ? static_cast<float>((keys[key].mTime - keys[first].mTime) / length) : 0.0f;
+}
+
+// Indices of the keys to keep so that interpolating between them stays within tolerance of every dropped key.
+// error(first, last, key) measures how far key is from the interpolation of first and last.
+template <typename Error>
+std::vector<unsigned int> reduceKeys(unsigned int count, float tolerance, Error error) {
+    std::vector<unsigned int> kept{};
+    if (count == 0) {
+        return kept;
+    }
+
+    kept.push_back(0);
+    auto first = 0u;
+    while (first + 1 < count) {
+        auto last = first + 1;
+        while (last + 1 < count) {
+            auto fits = true;
+            for (auto key = first + 1; key <= last && fits; key++) {
+                fits = error(first, last + 1, key) <= tolerance;
+            }
+            if (!fits) {
+                break;
+            }
+            last++;
+        }
+        kept.push_back(last);
+        first = last;
+    }
+    return kept;
+}
+
+// Position or scaling keys, each component quantized to 16 bits over the range of the track
+struct VectorTrack {
+    QuantizedTimes times{};
+    std::vector<uint16_t> values{};
+    aiVector3D minimum{};
+    aiVector3D extent{};
+
+    void build(const aiVectorKey* keys, unsigned int count, double duration, float tolerance) {
+        times.reset(duration);
+        values.clear();
+        minimum = aiVector3D(count ? keys[0].mValue : aiVector3D());
+        auto maximum = minimum;
+        for (auto i = 0u; i < count; i++) {
+            minimum = aiVector3D(std::min(minimum.x, keys[i].mValue.x), std::min(minimum.y, keys[i].mValue.y),
+                                 std::min(minimum.z, keys[i].mValue.z));
+            maximum = aiVector3D(std::max(maximum.x, keys[i].mValue.x), std::max(maximum.y, keys[i].mValue.y),
+                                 std::max(maximum.z, keys[i].mValue.z));
+        }
+        extent = maximum - minimum;
+
+        // A track that never moves needs only its first key
+        const auto range = std::max(std::max(extent.x, extent.y), extent.z);
+        const auto kept = range <= 0 ? std::vector<unsigned int>(std::min(count, 1u), 0) :
+                reduceKeys(count, tolerance * range, [keys](unsigned int first, unsigned int last, unsigned int key) {
+            const auto factor = keyFraction(keys, first, last, key);
+            const auto interpolated = (keys[last].mValue - keys[first].mValue) * factor + keys[first].mValue;
+            return (interpolated - keys[key].mValue).Length();
+        });
+
+        for (auto index : kept) {
+            times.push(keys[index].mTime);
+            values.push_back(quantize(keys[index].mValue.x, minimum.x, extent.x));
+            values.push_back(quantize(keys[index].mValue.y, minimum.y, extent.y));
+            values.push_back(quantize(keys[index].mValue.z, minimum.z, extent.z));
+        }
+    }
+
+    aiVector3D value(unsigned int index) const {
+        return aiVector3D(minimum.x + values[index * 3] * (extent.x / 65535.0f),
+                          minimum.y + values[index * 3 + 1] * (extent.y / 65535.0f),
+                          minimum.z + values[index * 3 + 2] * (extent.z / 65535.0f));
+    }
+
+    aiVector3D sample(double time, unsigned int& cursor, const aiVector3D& fallback) const {
+        const auto count = static_cast<unsigned int>(times.times.size());
+        if (count == 0) {
+            return fallback;
+        }
+        if (count == 1) {
+            return value(0);
+        }
+
+        const auto index = times.find(time, cursor);
+        const auto factor = static_cast<float>(times.factor(index, time));
+        const auto previous = value(index);
+        return (value(index + 1) - previous) * factor + previous;
+    }
+
+    std::size_t bytes() const {
+        return times.bytes() + values.size() * sizeof(uint16_t) + sizeof(minimum) + sizeof(extent);
+    }
+
+    static uint16_t quantize(float value, float minimum, float extent) {
+        if (extent <= 0) {
+            return 0;
+        }
+        return static_cast<uint16_t>(std::lround(std::min(std::max((value - minimum) / extent, 0.0f), 1.0f) * 65535));
+    }
+};
+
+// Rotation keys stored as their three smallest components, 15 bits each, with the index of the dropped largest
+// component in the top bits of the first two
+struct QuatTrack {
+    QuantizedTimes times{};
+    std::vector<uint16_t> values{};
+
+    void build(const aiQuatKey* keys, unsigned int count, double duration, float tolerance) {
+        times.reset(duration);
+        values.clear();
+
+        auto constant = true;
+        for (auto i = 1u; i < count && constant; i++) {
+            constant = angle(keys[0].mValue, keys[i].mValue) <= tolerance;
+        }
+
+        const auto kept = constant ? std::vector<unsigned int>(std::min(count, 1u), 0) :
+                reduceKeys(count, tolerance, [keys](unsigned int first, unsigned int last, unsigned int key) {
+            aiQuaternion interpolated;
+            aiQuaternion::Interpolate(interpolated, keys[first].mValue, keys[last].mValue,
+                                      keyFraction(keys, first, last, key));
+            return angle(interpolated, keys[key].mValue);
+        });
+
+        for (auto index : kept) {
+            times.push(keys[index].mTime);
+            encode(keys[index].mValue);
+        }
+    }
+
+    aiQuaternion value(unsigned int index) const {
+        const auto packed = &values[index * 3];
+        const auto largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+
+        float components[4];
+        auto sum = 0.0f;
+        for (auto i = 0, j = 0; i < 4; i++) {
+            if (i == largest) {
+                continue;
+            }
+            components[i] = ((packed[j++] & 0x7FFF) / 32767.0f * 2 - 1) * componentRange;
+            sum += components[i] * components[i];
+        }
+        components[largest] = std::sqrt(std::max(1 - sum, 0.0f));
+        return aiQuaternion(components[0], components[1], components[2], components[3]);
+    }
+
+    aiQuaternion sample(double time, unsigned int& cursor) const {
+        const auto count = static_cast<unsigned int>(times.times.size());
+        if (count == 0) {
+            return aiQuaternion();
+        }
+        if (count == 1) {
+            return value(0);
+        }
+
+        const auto index = times.find(time, cursor);
+        aiQuaternion rotation;
+        aiQuaternion::Interpolate(rotation, value(index), value(index + 1),
+                                  static_cast<float>(times.factor(index, time)));
+        return rotation;
+    }
+
+    std::size_t bytes() const {
+        return times.bytes() + values.size() * sizeof(uint16_t);
+    }
+
+    static float angle(const aiQuaternion& a, const aiQuaternion& b) {
+        const auto dot = std::abs(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z);
+        return 2 * std::acos(std::min(dot, 1.0f));
+    }
+
+private:
+    // Every component but the largest of a unit quaternion lies within +-1/sqrt(2)
+    static constexpr float componentRange = 0.70710678f;
+
+    void encode(aiQuaternion rotation) {
+        rotation.Normalize();
+        float components[4]{rotation.w, rotation.x, rotation.y, rotation.z};
+
+        auto largest = 0;
+        for (auto i = 1; i < 4; i++) {
+            if (std::abs(components[i]) > std::abs(components[largest])) {
+                largest = i;
+            }
+        }
+        // q and -q are the same rotation, so the dropped component can always be made positive
+        const auto sign = components[largest] < 0 ? -1.0f : 1.0f;
+
+        uint16_t packed[3];
+        for (auto i = 0, j = 0; i < 4; i++) {
+            if (i == largest) {
+                continue;
+            }
+            const auto normalised = std::min(std::max(sign * components[i] / componentRange, -1.0f), 1.0f);
+            packed[j++] = static_cast<uint16_t>(std::lround((normalised + 1) * 0.5f * 32767));
+        }
+        packed[0] |= (largest & 1) << 15;
+        packed[1] |= (largest >> 1) << 15;
+        values.insert(values.end(), packed, packed + 3);
+    }
+};
+
+// One animation channel after quantization and keyframe reduction
+struct CompressedChannel {
+    std::string name{};
+    VectorTrack position{};
+    QuatTrack rotation{};
+    VectorTrack scaling{};
+
+    void build(const aiNodeAnim* channel, double duration, const ClipTolerance& tolerance) {
+        name = channel->mNodeName.C_Str();
+        position.build(channel->mPositionKeys, channel->mNumPositionKeys, duration, tolerance.position);
+        rotation.build(channel->mRotationKeys, channel->mNumRotationKeys, duration, tolerance.rotation);
+        scaling.build(channel->mScalingKeys, channel->mNumScalingKeys, duration, tolerance.scaling);
+    }
+
+    // Local transform at the given time, translation * rotation * scale as in sampleChannel
+    aiMatrix4x4 sample(double time, KeyframeCursor& cursor) const {
+        return aiMatrix4x4(scaling.sample(time, cursor.scaling, aiVector3D(1)), rotation.sample(time, cursor.rotation),
+                           position.sample(time, cursor.position, aiVector3D()));
+    }
+
+    std::size_t bytes() const {
+        return position.bytes() + rotation.bytes() + scaling.bytes();
+    }
+
+    static std::size_t rawBytes(const aiNodeAnim* channel) {
+        return channel->mNumPositionKeys * sizeof(aiVectorKey) + channel->mNumRotationKeys * sizeof(aiQuatKey) +
+               channel->mNumScalingKeys * sizeof(aiVectorKey);
+    }
+};
@@ -0,0 +1,156 @@
+//  ========================================================================
+//  COSC422: Advanced Computer Graphics;  University of Canterbury (2019)
+//  ========================================================================
+
+// Imports every scene of the animation viewer through Assimp once and writes the result as a cooked file next to
+// the model, which the viewer maps instead of importing while the sources are unchanged. Also cuts the terrain
+// viewer's heightmaps into the tiled worlds its --world mode streams.
+
+#include <IL/il.h>
+
+#include "character.h"
+#include "scenes.h"
+#include "terrain_tiles.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Tiles across the world, each of 128 x 128 cells, so 4096 heightmap cells or eight copies of the heightmap
+const uint32_t terrainTilesAcross = 32;
+const uint32_t terrainTileSize = 128;
+
+// Cuts a world from mirrored copies of the heightmap, drawn at the scale the terrain viewer draws the heightmap on its
+// own, 100 units across and 10 high, with a copy centred on the origin. Returns false if it was already up to date.
+bool cookTerrainWorld(const std::string& heightMap, const std::string& fileName, bool force, ThreadPool& threadPool)
+{
+	const auto stamp = fileStamp(heightMap);
+	if (!force)
+	{
+		try
+		{
+			const TerrainTileFile existing(fileName);
+			const auto& header = existing.getHeader();
+			if (header.sourceSize == stamp.size && header.sourceModified == stamp.modified &&
+			    header.tilesAcross == terrainTilesAcross && header.tileSize == terrainTileSize)
+			{
+				return false;
+			}
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	// Rows from the top, which the viewer places furthest from the camera
+	ILuint image = ilGenImage();
+	ilBindImage(image);
+	ilEnable(IL_ORIGIN_SET);
+	ilOriginFunc(IL_ORIGIN_UPPER_LEFT);
+	if (!ilLoadImage(heightMap.c_str()) || !ilConvertImage(IL_LUMINANCE, IL_UNSIGNED_SHORT))
+	{
+		ilDeleteImage(image);
+		throw std::exception{};
+	}
+	const auto width = ilGetInteger(IL_IMAGE_WIDTH);
+	const auto height = ilGetInteger(IL_IMAGE_HEIGHT);
+	const auto data = reinterpret_cast<const uint16_t*>(ilGetData());
+	const std::vector<uint16_t> samples(data, data + width * height);
+	ilDeleteImage(image);
+
+	// Alternate copies are mirrored so the world has no seams
+	const auto worldCentre = static_cast<int>(terrainTilesAcross * terrainTileSize / 2);
+	const auto mirror = [worldCentre](int sample, int size)
+	{
+		const auto period = 2 * (size - 1);
+		const auto position = ((sample - worldCentre + (size - 1) / 2) % period + period) % period;
+		return position < size ? position : period - position;
+	};
+	writeTerrainTiles(fileName, [&](int x, int y)
+	{
+		return samples[mirror(y, height) * width + mirror(x, width)];
+	}, terrainTileSize, terrainTilesAcross, 100.0f / (width - 1), 10.0f, stamp.size, stamp.modified, threadPool);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	ilInit();
+
+	ThreadPool threadPool{};
+
+	// Pass --force to cook scenes whose cooked files are already up to date
+	const auto force = argc > 1 && std::string(argv[1]) == "--force";
+
+	std::vector<std::string> cookedFiles{};
+	auto failures = 0;
+	for (auto sceneId = 0; sceneId < sceneCount; sceneId++)
+	{
+		for (auto dwarfSpecial : {false, true})
+		{
+			const auto source = sceneSource(sceneId, dwarfSpecial);
+			const auto fileName = source.cookedFile();
+			if (std::find(cookedFiles.begin(), cookedFiles.end(), fileName) != cookedFiles.end())
+			{
+				continue;
+			}
+			cookedFiles.push_back(fileName);
+
+			try
+			{
+				if (!force)
+				{
+					// A corrupt cooked file is recooked like a stale one
+					Character existing{};
+					try
+					{
+						if (existing.loadCooked(source, 0))
+						{
+							continue;
+						}
+					}
+					catch (const std::exception&)
+					{
+					}
+				}
+
+				// The clip's ticks per second is cooked as given, the viewer picks its own default when there is none
+				Character character{};
+				character.importScene(source, 0);
+				character.bake(true, 0, &threadPool);
+				character.buildSkinnedMeshes();
+				character.computeBounds();
+				character.writeCooked(source);
+				std::cout << "Cooked " << fileName << std::endl;
+			}
+			catch (const std::exception&)
+			{
+				std::cout << "Failed to cook " << fileName << std::endl;
+				failures++;
+			}
+		}
+	}
+
+	for (const std::string heightMap : {"data/HeightMap1.tga", "data/HeightMap2.png"})
+	{
+		const auto fileName = heightMap.substr(0, heightMap.find_last_of('.')) + ".tiles";
+		try
+		{
+			if (cookTerrainWorld(heightMap, fileName, force, threadPool))
+			{
+				std::cout << "Cooked " << fileName << std::endl;
+			}
+		}
+		catch (const std::exception&)
+		{
+			std::cout << "Failed to cook " << fileName << std::endl;
+			failures++;
+		}
+	}
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
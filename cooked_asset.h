@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <assimp/scene.h>
+
+// Bump whenever the layout below, VertexWeights, the interleaved vertex layouts or what the cooker bakes changes, so
+// old files are recooked
+const uint32_t cookedVersion = 5;
+const char cookedMagic[8] = {'C', 'O', 'S', 'C', 'C', 'O', 'O', 'K'};
+// Every array starts on a cache line, which also satisfies the alignment of the SIMD skinning kernels
+const std::size_t cookedAlignment = 64;
+
+// Size and modification time of a source file when it was cooked, both zero for a missing file
+struct CookedStamp {
+    int64_t size;
+    int64_t modified;
+
+    bool operator==(const CookedStamp& other) const {
+        return size == other.size && modified == other.modified;
+    }
+};
+
+inline CookedStamp fileStamp(const std::string& fileName) {
+    struct stat status{};
+    if (fileName.empty() || stat(fileName.c_str(), &status) != 0) {
+        return {0, 0};
+    }
+    return {static_cast<int64_t>(status.st_size), static_cast<int64_t>(status.st_mtime)};
+}
+
+// Array offsets are in bytes from the start of the file
+struct CookedMesh {
+    uint32_t materialIndex;
+    uint32_t vertexCount;
+    // Points, then lines, then triangles
+    uint32_t indexCounts[3];
+    uint32_t hasNormals;
+    uint32_t hasTexCoords;
+    uint32_t hasColours;
+    uint64_t positions;
+    uint64_t normals;
+    uint64_t texCoords;
+    uint64_t colours;
+    uint64_t indices;
+    // Padded to whole skinning blocks
+    uint64_t weights;
+    // GpuSkinnedVertex and StaticVertex arrays, uploaded as they are
+    uint64_t gpuVertices;
+    uint64_t staticVertices;
+};
+
+struct CookedMaterial {
+    aiColor4D diffuse;
+    uint32_t hasDiffuse;
+    // Diffuse texture as named by the model, empty for none
+    char texture[256];
+};
+
+struct CookedTexture {
+    char fileName[256];
+    char formatHint[16];
+    // Zero height means data holds width bytes of a compressed image, otherwise width * height BGRA texels
+    uint32_t width;
+    uint32_t height;
+    uint64_t data;
+};
+
+struct CookedBone {
+    aiMatrix4x4 offsetMatrix;
+    aiMatrix4x4 localTransformation;
+    int32_t parentIndex;
+};
+
+// A channel binding with retargeting already resolved
+struct CookedChannel {
+    char name[128];
+    int32_t bone;
+    uint32_t frozen;
+    uint32_t retargeted;
+    double timeScale;
+    aiMatrix4x4 correction;
+    uint32_t positionCount;
+    uint32_t rotationCount;
+    uint32_t scalingCount;
+    uint64_t positionKeys;
+    uint64_t rotationKeys;
+    uint64_t scalingKeys;
+};
+
+struct CookedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t maxInfluences;
+    CookedStamp model;
+    CookedStamp animation;
+
+    int32_t duration;
+    // As given by the clip, zero when the clip leaves it to the viewer
+    double ticksPerSecond;
+    aiVector3D boundsMin;
+    aiVector3D boundsMax;
+    aiVector3D boundsCenter;
+    float boundsScale;
+
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t textureCount;
+    uint32_t boneCount;
+    uint32_t channelCount;
+    uint64_t meshes;
+    uint64_t materials;
+    uint64_t textures;
+    uint64_t bones;
+    uint64_t channels;
+    // Every tick of the clip, each the 3x4 skinning matrices of every bone
+    uint64_t poses;
+};
+
+// Read only view of a whole file, pages are loaded by the OS as they are first touched
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& fileName) {
+        const auto file = open(fileName.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw std::exception{};
+        }
+
+        struct stat status{};
+        if (fstat(file, &status) != 0 || status.st_size <= 0) {
+            close(file);
+            throw std::exception{};
+        }
+        length = static_cast<std::size_t>(status.st_size);
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (mapping == MAP_FAILED) {
+            throw std::exception{};
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        munmap(mapping, length);
+    }
+
+    // Array of count Ts at the given offset, throws if it would run past the end of the file or is misaligned
+    template <typename T>
+    const T* at(uint64_t offset, std::size_t count) const {
+        if (offset % alignof(T) != 0 || offset > length || count > (length - offset) / sizeof(T)) {
+            throw std::exception{};
+        }
+        return reinterpret_cast<const T*>(static_cast<const char*>(mapping) + offset);
+    }
+
+    std::size_t size() const {
+        return length;
+    }
+
+private:
+    void* mapping{};
+    std::size_t length{};
+};
+
+// Builds a cooked file in memory: arrays are appended first, then the tables pointing at them, then the header is
+// filled in at the front
+class CookedWriter {
+public:
+    CookedWriter() : bytes(sizeof(CookedHeader)) {}
+
+    template <typename T>
+    uint64_t append(const T* data, std::size_t count) {
+        bytes.resize((bytes.size() + cookedAlignment - 1) / cookedAlignment * cookedAlignment);
+        const auto offset = static_cast<uint64_t>(bytes.size());
+        if (count > 0) {
+            bytes.resize(bytes.size() + count * sizeof(T));
+            std::memcpy(bytes.data() + offset, data, count * sizeof(T));
+        }
+        return offset;
+    }
+
+    // Written beside the target and renamed over it, so an interrupted cook never leaves a partial file behind
+    void write(const std::string& fileName, const CookedHeader& header) {
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        const auto temporaryName = fileName + ".tmp";
+        std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+        file.close();
+        if (!file || std::rename(temporaryName.c_str(), fileName.c_str()) != 0) {
+            std::remove(temporaryName.c_str());
+            throw std::exception{};
+        }
+    }
+
+private:
+    std::vector<char> bytes;
+};
+
+// Deletes a channel whose keys belong to a mapped file, leaving the keys to the mapping
+struct MappedChannelDeleter {
+    void operator()(aiNodeAnim* channel) const {
+        channel->mPositionKeys = nullptr;
+        channel->mRotationKeys = nullptr;
+        channel->mScalingKeys = nullptr;
+        delete channel;
+    }
+};
+
+using MappedChannel = std::unique_ptr<aiNodeAnim, MappedChannelDeleter>;
@@ -0,0 +1,61 @@
+#version 420 compatibility
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in ivec4 boneIndices;
+layout(location = 4) in vec4 boneWeights;
+layout(location = 5) in vec4 vertexColour;
+layout(location = 6) in mat4 instanceTransform;
+layout(location = 10) in float instanceTimeOffset;
+
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec2 outTexCoord;
+layout(location = 3) out vec4 outColour;
+layout(location = 4) out vec4 outShadowCoord;
+
+// Every baked tick of the clip, each bone stored as the top three rows of its matrix
+layout(binding = 1) uniform samplerBuffer bakedPalette;
+
+uniform bool useVertexColour;
+uniform float time;
+uniform int duration;
+uniform int boneCount;
+uniform mat4 shadowMatrix;
+
+// Inverse transpose of the upper 3x3 of a bone matrix, up to scale, as the cross products of its rows. The sign of the
+// determinant keeps normals facing out under mirroring.
+vec3 transformNormal(mat3x4 m, vec3 n) {
+    vec3 c0 = cross(m[1].xyz, m[2].xyz);
+    vec3 c1 = cross(m[2].xyz, m[0].xyz);
+    vec3 c2 = cross(m[0].xyz, m[1].xyz);
+    return vec3(dot(c0, n), dot(c1, n), dot(c2, n)) * sign(dot(m[0].xyz, c0));
+}
+
+mat3x4 fetchBone(int tick, int bone) {
+    int texel = (tick * boneCount + bone) * 3;
+    return mat3x4(texelFetch(bakedPalette, texel), texelFetch(bakedPalette, texel + 1), texelFetch(bakedPalette, texel + 2));
+}
+
+void main() {
+    float instanceTime = mod(time + instanceTimeOffset, float(duration));
+    int tick = int(instanceTime);
+    int nextTick = (tick + 1) % duration;
+    float factor = instanceTime - float(tick);
+
+    mat3x4 skinning = mat3x4(0);
+    for (int i = 0; i < 4; i++) {
+        skinning += (fetchBone(tick, boneIndices[i]) * (1 - factor) + fetchBone(nextTick, boneIndices[i]) * factor) * boneWeights[i];
+    }
+    vec3 skinnedPosition = vec4(position, 1) * skinning;
+    vec3 skinnedNormal = transformNormal(skinning, normal);
+
+    vec4 worldPosition = instanceTransform * vec4(skinnedPosition, 1);
+    outPosition = (gl_ModelViewMatrix * worldPosition).xyz;
+    outNormal = gl_NormalMatrix * (mat3(instanceTransform) * skinnedNormal);
+    outTexCoord = texCoord;
+    outColour = useVertexColour ? vertexColour : gl_Color;
+    outShadowCoord = shadowMatrix * vec4(outPosition, 1);
+    gl_Position = gl_ModelViewProjectionMatrix * worldPosition;
+}
@@ -0,0 +1,65 @@
+#version 420 compatibility
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec4 colour;
+layout(location = 4) in vec4 shadowCoord;
+
+layout(location = 0) out vec4 outColour;
+
+layout(binding = 0) uniform sampler2D diffuseTexture;
+layout(binding = 2) uniform sampler2DShadow shadowMap;
+
+// Set while rendering the shadow map, when only depth is written
+uniform bool depthOnly;
+uniform bool lighting;
+uniform bool useTexture;
+// Colour of unlit surfaces, such as the floor, where they are in shadow
+uniform vec4 shadowColour;
+
+// Fraction of the light reaching this fragment, filtered over 3x3 shadow map texels. Anything outside the map is lit.
+float lightVisibility() {
+    vec3 coord = shadowCoord.xyz / shadowCoord.w;
+    // Receivers past the far plane, like the floor, still compare behind whatever the map holds but in front of its clear
+    coord.z = min(coord.z, 1);
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0));
+    float visibility = 0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            visibility += texture(shadowMap, vec3(coord.xy + vec2(x, y) * texel, coord.z));
+        }
+    }
+    return visibility / 9;
+}
+
+// Matches the fixed function light 0 setup, with diffuse and specular light removed where the shadow map is occluded
+void main() {
+    if (depthOnly) {
+        outColour = colour;
+        return;
+    }
+
+    float visibility = lightVisibility();
+    if (!lighting) {
+        vec4 surface = useTexture ? colour * texture(diffuseTexture, texCoord) : colour;
+        outColour = mix(shadowColour, surface, visibility);
+        return;
+    }
+
+    vec3 n = normalize(normal);
+    vec3 l = normalize(gl_LightSource[0].position.xyz - position * gl_LightSource[0].position.w);
+    vec3 h = normalize(l + vec3(0, 0, 1));
+
+    vec3 ambient = colour.rgb * (gl_LightSource[0].ambient.rgb + gl_LightModel.ambient.rgb);
+    vec3 diffuse = colour.rgb * gl_LightSource[0].diffuse.rgb * max(dot(n, l), 0);
+    vec3 specular = vec3(0);
+    if (dot(n, l) > 0) {
+        specular = gl_FrontMaterial.specular.rgb * gl_LightSource[0].specular.rgb * pow(max(dot(n, h), 0), gl_FrontMaterial.shininess);
+    }
+
+    outColour = vec4(ambient + (diffuse + specular) * visibility, colour.a);
+    if (useTexture) {
+        outColour *= texture(diffuseTexture, texCoord);
+    }
+}
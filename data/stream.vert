@@ -0,0 +1,21 @@
+#version 420 compatibility
+
+// Vertices already in their final pose, either skinned on the CPU and streamed or never skinned like the floor, lit
+// by data/skinning.frag the same way as the GPU skinned ones
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec2 outTexCoord;
+layout(location = 3) out vec4 outColour;
+layout(location = 4) out vec4 outShadowCoord;
+
+// Eye space to shadow map texture coordinates and depth
+uniform mat4 shadowMatrix;
+
+void main() {
+    outPosition = (gl_ModelViewMatrix * gl_Vertex).xyz;
+    outNormal = gl_NormalMatrix * gl_Normal;
+    outTexCoord = gl_MultiTexCoord0.xy;
+    outColour = gl_Color;
+    outShadowCoord = shadowMatrix * vec4(outPosition, 1);
+    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+}
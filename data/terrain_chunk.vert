@@ -0,0 +1,26 @@
+#version 450 core
+
+layout (location = 0) in vec4 position;
+// Origin of the chunk in x and z, its size, then the layer of its tile in the cache
+layout (location = 1) in vec4 chunk;
+
+layout (location = 0) out vec3 tileLookup;
+layout (location = 1) out float skirt;
+
+layout(binding = 0) uniform sampler2DArray heightTiles;
+
+uniform float heightScale;
+uniform int tileSize;
+
+void main() {
+    // The grid reaches a patch past the chunk on every side, and those vertices fold back onto its edge to hang a
+    // skirt that hides any gap to a neighbour of another level
+    vec2 local = position.xy + 0.5;
+    vec2 clamped = clamp(local, 0, 1);
+    skirt = clamped == local ? 0 : 1;
+
+    // Sample centres, so the tile's edge samples sit exactly on the chunk's edges
+    tileLookup = vec3((clamped * tileSize + 0.5) / (tileSize + 1), chunk.w);
+    vec2 world = chunk.xy + clamped * chunk.z;
+    gl_Position = vec4(world.x, texture(heightTiles, tileLookup).r * heightScale, world.y, 1);
+}
@@ -0,0 +1,20 @@
+#version 450 core
+
+layout(location = 0) in vec2 texCoord;
+
+layout(location = 0) out vec4 outColour;
+
+layout(binding = 3) uniform sampler2D water;
+
+layout(std140) uniform SceneInputData {
+    mat4 projectionView;
+    vec3 cameraPosition;
+    vec3 directionLight;
+    float ambientLight;
+};
+
+void main() {
+    // Lit as terrain.frag lights flat ground
+    float lighting = clamp(ambientLight + clamp(directionLight.y, 0, 1), 0, 1);
+    outColour = vec4(lighting * texture(water, texCoord).rgb, 1);
+}
@@ -0,0 +1,22 @@
+#version 450 core
+
+layout(location = 0) out vec2 texCoord;
+
+layout(std140) uniform SceneInputData {
+    mat4 projectionView;
+    vec3 cameraPosition;
+    vec3 directionLight;
+    float ambientLight;
+};
+
+uniform float waterHeight;
+// Half the width of the quad, and how many times the texture repeats across it
+uniform float size;
+uniform float textureScale;
+
+void main() {
+    // A triangle strip of four corners, from the vertex index alone
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = projectionView * vec4((corner.x * 2 - 1) * size, waterHeight, (corner.y * 2 - 1) * size, 1);
+    texCoord = corner * textureScale;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <IL/il.h>
+
+// Command line options shared by the viewers, for running without a window:
+//   --headless <frames>  render that many frames into an offscreen framebuffer and print how long each took
+//   --image <file>       save the last frame, in the format DevIL picks from the extension
+struct HeadlessOptions {
+    int frames{0};
+    std::string imageFile{};
+
+    bool enabled() const {
+        return frames > 0;
+    }
+};
+
+inline HeadlessOptions parseHeadlessOptions(int argc, char** argv) {
+    HeadlessOptions options{};
+    for (auto i = 1; i + 1 < argc; i++) {
+        const std::string option = argv[i];
+        if (option == "--headless") {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--image") {
+            options.imageFile = argv[++i];
+        }
+    }
+    return options;
+}
+
+// OpenGL context without a window or display server, from EGL on Mesa's surfaceless platform, which falls back to
+// the llvmpipe software rasterizer when there is no GPU. Everything is drawn into a framebuffer object the size the
+// window would have been, single sampled so saved images do not depend on the driver's resolve.
+class HeadlessContext {
+public:
+    HeadlessContext(int width, int height, int major, int minor, bool core) : width(width), height(height) {
+        const auto clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (clientExtensions && std::string(clientExtensions).find("EGL_MESA_platform_surfaceless") != std::string::npos) {
+            display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        } else {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+            std::cerr << "Unable to initialize EGL" << std::endl;
+            throw std::exception{};
+        }
+
+        const EGLint attributes[]{
+                EGL_CONTEXT_MAJOR_VERSION, major,
+                EGL_CONTEXT_MINOR_VERSION, minor,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+                EGL_NONE
+        };
+        context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cerr << "Unable to create an OpenGL " << major << "." << minor << " context through EGL" << std::endl;
+            throw std::exception{};
+        }
+
+        // GLEW built for GLX loads every entry point, then reports that there is no GLX display to go with them
+        const auto result = glewInit();
+        if (result != GLEW_OK && result != GLEW_ERROR_NO_GLX_DISPLAY) {
+            std::cerr << "Unable to initialize GLEW: " << glewGetErrorString(result) << std::endl;
+            throw std::exception{};
+        }
+        std::cout << "Headless " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER) << std::endl;
+
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Headless framebuffer is incomplete" << std::endl;
+            throw std::exception{};
+        }
+        bind();
+    }
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    ~HeadlessContext() {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+    // Makes the offscreen framebuffer the target of everything the program would have drawn to the window
+    void bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // Saves the colour buffer as it stands, DevIL's lower left origin matching the rows glReadPixels returns
+    bool saveImage(const std::string& fileName) const {
+        std::vector<unsigned char> pixels(width * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        ILuint image;
+        ilGenImages(1, &image);
+        ilBindImage(image);
+        auto saved = ilTexImage(width, height, 1, 4, IL_RGBA, IL_UNSIGNED_BYTE, pixels.data()) != IL_FALSE;
+        if (saved) {
+            ilEnable(IL_FILE_OVERWRITE);
+            saved = ilSaveImage(fileName.c_str()) != IL_FALSE;
+        }
+        ilDeleteImages(1, &image);
+
+        if (saved) {
+            std::cout << "Saved " << fileName << std::endl;
+        } else {
+            std::cerr << "Unable to save " << fileName << std::endl;
+        }
+        return saved;
+    }
+
+private:
+    int width;
+    int height;
+    EGLDisplay display{EGL_NO_DISPLAY};
+    EGLContext context{EGL_NO_CONTEXT};
+    GLuint framebuffer{};
+    GLuint renderbuffers[2]{};
+};
+
+// Runs the given number of frames back to back, each finished with glFinish so its time covers the GPU's work as
+// well as the CPU's, then prints every frame's time and a summary. Returns false if the image could not be saved.
+inline bool runHeadless(const HeadlessOptions& options, const HeadlessContext& context,
+                        const std::function<void(int frame)>& renderFrame) {
+    std::vector<double> times{};
+    for (auto frame = 0; frame < options.frames; frame++) {
+        const auto start = std::chrono::steady_clock::now();
+        // Rebound every frame, in case setup or the last frame left another framebuffer bound
+        context.bind();
+        renderFrame(frame);
+        glFinish();
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        times.push_back(elapsed.count());
+        std::cout << "Frame " << frame << ": " << elapsed.count() << " ms" << std::endl;
+    }
+
+    auto sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    auto total = 0.0;
+    for (auto time : times) {
+        total += time;
+    }
+    std::cout << "Rendered " << times.size() << " frames in " << total << " ms: min " << sorted.front()
+              << " ms, median " << sorted[sorted.size() / 2] << " ms, max " << sorted.back() << " ms" << std::endl;
+
+    return options.imageFile.empty() || context.saveImage(options.imageFile);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <jpeglib.h>
+#include <png.h>
+
+// Decoders for the common texture formats that keep no global state, so any number of threads can decode at once,
+// unlike DevIL. Each fills pixels with RGBA texels, bottom row first as OpenGL expects, and returns false, leaving
+// them empty, if the image is not one it reads or is corrupt.
+
+inline bool decodePng(const void* data, std::size_t size, int& width, int& height, std::vector<unsigned char>& pixels) {
+    png_image image{};
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&image, data, size)) {
+        return false;
+    }
+    image.format = PNG_FORMAT_RGBA;
+    width = static_cast<int>(image.width);
+    height = static_cast<int>(image.height);
+    pixels.resize(PNG_IMAGE_SIZE(image));
+    // A negative stride writes the rows bottom up
+    if (!png_image_finish_read(&image, nullptr, pixels.data(), -static_cast<png_int_32>(PNG_IMAGE_ROW_STRIDE(image)),
+                               nullptr)) {
+        pixels.clear();
+        return false;
+    }
+    return true;
+}
+
+// libjpeg reports errors by calling error_exit, which must not return, so it jumps back out of the decode
+struct JpegErrorManager {
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+};
+
+inline bool decodeJpeg(const void* data, std::size_t size, int& width, int& height, std::vector<unsigned char>& pixels) {
+    jpeg_decompress_struct info{};
+    JpegErrorManager error{};
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = [](j_common_ptr common) {
+        std::longjmp(reinterpret_cast<JpegErrorManager*>(common->err)->jump, 1);
+    };
+    error.manager.output_message = [](j_common_ptr) {
+    };
+    // Everything that owns memory is made before the jump target, so jumping back skips no destructors
+    std::vector<unsigned char> row{};
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        pixels.clear();
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, static_cast<const unsigned char*>(data), static_cast<unsigned long>(size));
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    width = static_cast<int>(info.output_width);
+    height = static_cast<int>(info.output_height);
+    pixels.resize(std::size_t(width) * height * 4);
+    row.resize(std::size_t(width) * 3);
+    while (info.output_scanline < info.output_height) {
+        auto rowPointer = row.data();
+        const auto y = height - 1 - static_cast<int>(info.output_scanline);
+        jpeg_read_scanlines(&info, &rowPointer, 1);
+        const auto target = pixels.data() + std::size_t(y) * width * 4;
+        for (auto x = 0; x < width; x++) {
+            target[x * 4] = row[x * 3];
+            target[x * 4 + 1] = row[x * 3 + 1];
+            target[x * 4 + 2] = row[x * 3 + 2];
+            target[x * 4 + 3] = 255;
+        }
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return true;
+}
+
+// Only uncompressed 24 and 32 bit bitmaps, which are all the models use
+inline bool decodeBmp(const void* data, std::size_t size, int& width, int& height, std::vector<unsigned char>& pixels) {
+    const auto bytes = static_cast<const unsigned char*>(data);
+    const auto read32 = [bytes](std::size_t offset) {
+        return static_cast<uint32_t>(bytes[offset] | bytes[offset + 1] << 8 | bytes[offset + 2] << 16 |
+                                     static_cast<uint32_t>(bytes[offset + 3]) << 24);
+    };
+    if (size < 54 || bytes[0] != 'B' || bytes[1] != 'M') {
+        return false;
+    }
+    const auto offset = read32(10);
+    const auto signedWidth = static_cast<int32_t>(read32(18));
+    const auto signedHeight = static_cast<int32_t>(read32(22));
+    const auto bitsPerPixel = bytes[28] | bytes[29] << 8;
+    if (signedWidth <= 0 || signedHeight == 0 || (bitsPerPixel != 24 && bitsPerPixel != 32) || read32(30) != 0) {
+        return false;
+    }
+
+    // Rows are padded to four bytes and stored bottom up, unless the height is negative
+    width = signedWidth;
+    height = signedHeight < 0 ? -signedHeight : signedHeight;
+    const auto pixelBytes = bitsPerPixel / 8;
+    const auto stride = (std::size_t(width) * pixelBytes + 3) / 4 * 4;
+    if (offset + stride * height > size) {
+        return false;
+    }
+    pixels.resize(std::size_t(width) * height * 4);
+    for (auto y = 0; y < height; y++) {
+        const auto source = bytes + offset + stride * (signedHeight < 0 ? height - 1 - y : y);
+        const auto target = pixels.data() + std::size_t(y) * width * 4;
+        for (auto x = 0; x < width; x++) {
+            target[x * 4] = source[x * pixelBytes + 2];
+            target[x * 4 + 1] = source[x * pixelBytes + 1];
+            target[x * 4 + 2] = source[x * pixelBytes];
+            // The fourth byte of an uncompressed 32 bit bitmap is padding, not alpha
+            target[x * 4 + 3] = 255;
+        }
+    }
+    return true;
+}
+
+// Picks the decoder from the image's leading bytes rather than its name, so misnamed files still decode
+inline bool decodeImageReentrant(const void* data, std::size_t size, int& width, int& height,
+                                 std::vector<unsigned char>& pixels) {
+    const auto bytes = static_cast<const unsigned char*>(data);
+    if (size >= 8 && png_sig_cmp(bytes, 0, 8) == 0) {
+        return decodePng(data, size, width, height, pixels);
+    }
+    if (size >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF) {
+        return decodeJpeg(data, size, width, height, pixels);
+    }
+    if (size >= 2 && bytes[0] == 'B' && bytes[1] == 'M') {
+        return decodeBmp(data, size, width, height, pixels);
+    }
+    return false;
+}
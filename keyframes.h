@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+
+#include <assimp/scene.h>
+
+// Last key used for each key array of a channel, so playback moving forward finds the next key without searching
+struct KeyframeCursor {
+    unsigned int position{};
+    unsigned int rotation{};
+    unsigned int scaling{};
+};
+
+// Finds the key i such that keys[i].mTime <= time < keys[i + 1].mTime, clamped to the first and last pair of keys
+// Checks the cached key and the one after it first, falling back to a binary search
+template <typename Key>
+unsigned int findKey(const Key* keys, unsigned int count, double time, unsigned int& cursor) {
+    if (cursor + 1 < count && keys[cursor].mTime <= time) {
+        if (time < keys[cursor + 1].mTime) {
+            return cursor;
+        }
+        if (cursor + 2 < count && time < keys[cursor + 2].mTime) {
+            return ++cursor;
+        }
+    }
+
+    const auto upper = std::upper_bound(keys, keys + count, time, [](double t, const Key& key) {
+        return t < key.mTime;
+    });
+    const auto index = upper == keys ? 0u : static_cast<unsigned int>(upper - keys - 1);
+    cursor = std::min(index, count - 2);
+    return cursor;
+}
+
+// Fraction of the way between keys[index] and keys[index + 1], clamped to [0, 1]
+template <typename Key>
+double keyFactor(const Key* keys, unsigned int index, double time) {
+    const auto length = keys[index + 1].mTime - keys[index].mTime;
+    if (length <= 0) {
+        return time < keys[index].mTime ? 0.0 : 1.0;
+    }
+    return std::min(std::max((time - keys[index].mTime) / length, 0.0), 1.0);
+}
+
+inline aiVector3D sampleVectorKeys(const aiVectorKey* keys, unsigned int count, double time, unsigned int& cursor,
+                                   const aiVector3D& fallback) {
+    if (count == 0) {
+        return fallback;
+    }
+    if (count == 1) {
+        return keys[0].mValue;
+    }
+
+    const auto index = findKey(keys, count, time, cursor);
+    const auto factor = static_cast<float>(keyFactor(keys, index, time));
+    if (factor <= 0) {
+        return keys[index].mValue;
+    }
+    if (factor >= 1) {
+        return keys[index + 1].mValue;
+    }
+
+    const auto previous = keys[index].mValue;
+    const auto current = keys[index + 1].mValue;
+    return (current - previous).SymMul(aiVector3D(factor)) + previous;
+}
+
+inline aiQuaternion sampleQuatKeys(const aiQuatKey* keys, unsigned int count, double time, unsigned int& cursor) {
+    if (count == 0) {
+        return aiQuaternion();
+    }
+    if (count == 1) {
+        return keys[0].mValue;
+    }
+
+    const auto index = findKey(keys, count, time, cursor);
+    const auto factor = static_cast<float>(keyFactor(keys, index, time));
+    if (factor <= 0) {
+        return keys[index].mValue;
+    }
+    if (factor >= 1) {
+        return keys[index + 1].mValue;
+    }
+
+    aiQuaternion rotation;
+    aiQuaternion::Interpolate(rotation, keys[index].mValue, keys[index + 1].mValue, factor);
+    return rotation;
+}
+
+// Local transform of a channel at the given time, translation * rotation * scale
+inline aiMatrix4x4 sampleChannel(const aiNodeAnim* channel, double time, KeyframeCursor& cursor) {
+    const auto position = sampleVectorKeys(channel->mPositionKeys, channel->mNumPositionKeys, time, cursor.position,
+                                           aiVector3D());
+    const auto rotation = sampleQuatKeys(channel->mRotationKeys, channel->mNumRotationKeys, time, cursor.rotation);
+    const auto scaling = sampleVectorKeys(channel->mScalingKeys, channel->mNumScalingKeys, time, cursor.scaling,
+                                          aiVector3D(1));
+
+    return aiMatrix4x4(scaling, rotation, position);
+}
@@ -12,19 +12,29 @@
 
 #include <iostream>
 #include <fstream>
+#include <vector>
 using namespace std;
 
-void loadTGA(string filename)
+//Pixels of an image, with R and B swapped into RGB order for colour images
+struct TGAImage
+{
+	short int wid, hgt;
+	int nbytes;         //No. of bytes per pixel
+	vector<char> imageData;
+};
+
+//Reads an image without touching OpenGL, returns false if the file cannot be opened or is not uncompressed
+inline bool readTGA(string filename, TGAImage& image)
 {
     char id, cmap, imgtype, bpp, c_garb;
-    char* imageData, temp;
-    short int s_garb, wid, hgt;
-    int nbytes, size, indx;
+    char temp;
+    short int s_garb;
+    int size, indx;
     ifstream file( filename.c_str(), ios::in | ios::binary);
 	if(!file)
 	{
 		cout << "*** Error opening image file: " << filename.c_str() << endl;
-		exit(1);
+		return false;
 	}
 	file.read (&id, 1);
 	file.read (&cmap, 1);
@@ -32,7 +42,7 @@ void loadTGA(string filename)
 	if(imgtype != 2 && imgtype != 3 )   //2= colour (uncompressed),  3 = greyscale (uncompressed)
 	{
 		cout << "*** Incompatible image type: " << (int)imgtype << endl;
-		exit(1);
+		return false;
 	}
 	//Color map specification
 	file.read ((char*)&s_garb, 2);
@@ -41,39 +51,48 @@ void loadTGA(string filename)
 	//Image specification
 	file.read ((char*)&s_garb, 2);  //x origin
 	file.read ((char*)&s_garb, 2);  //y origin
-	file.read ((char*)&wid, 2);     //image width								    
-	file.read ((char*)&hgt, 2);     //image height
+	file.read ((char*)&image.wid, 2);     //image width								    
+	file.read ((char*)&image.hgt, 2);     //image height
 	file.read (&bpp, 1);     //bits per pixel
 	file.read (&c_garb, 1);  //img descriptor
-	nbytes = bpp / 8;           //No. of bytes per pixels
-	size = wid * hgt * nbytes;  //Total number of bytes to be read
-	imageData = new char[size];
-	file.read(imageData, size);
-	//cout << ">>>" << nbytes << " " << wid << " " << hgt << endl;
-	if(nbytes > 2)   //swap R and B
+	image.nbytes = bpp / 8;           //No. of bytes per pixels
+	size = image.wid * image.hgt * image.nbytes;  //Total number of bytes to be read
+	image.imageData.resize(size);
+	file.read(image.imageData.data(), size);
+	//cout << ">>>" << image.nbytes << " " << image.wid << " " << image.hgt << endl;
+	if(image.nbytes > 2)   //swap R and B
 	{
-	    for(int i = 0; i < wid*hgt;  i++)
+	    for(int i = 0; i < image.wid*image.hgt;  i++)
 	    {
-	        indx = i*nbytes;
-	        temp = imageData[indx];
-	        imageData[indx] = imageData[indx+2];
-	        imageData[indx+2] = temp;
+	        indx = i*image.nbytes;
+	        temp = image.imageData[indx];
+	        image.imageData[indx] = image.imageData[indx+2];
+	        image.imageData[indx+2] = temp;
         }
     }
+	return true;
+}
+
+inline void loadTGA(string filename)
+{
+	TGAImage image;
+	if(!readTGA(filename, image))
+	{
+		exit(1);
+	}
 
-	switch (nbytes)
+	switch (image.nbytes)
 	{
 	     case 1:
-	         glTexImage2D(GL_TEXTURE_2D, 0, 1, wid, hgt, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, imageData);
+	         glTexImage2D(GL_TEXTURE_2D, 0, 1, image.wid, image.hgt, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, image.imageData.data());
 	         break;
 	     case 3:
-	         glTexImage2D(GL_TEXTURE_2D, 0, 3, wid, hgt, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+	         glTexImage2D(GL_TEXTURE_2D, 0, 3, image.wid, image.hgt, 0, GL_RGB, GL_UNSIGNED_BYTE, image.imageData.data());
 	         break;
 	     case 4:
-	         glTexImage2D(GL_TEXTURE_2D, 0, 4, wid, hgt, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+	         glTexImage2D(GL_TEXTURE_2D, 0, 4, image.wid, image.hgt, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.imageData.data());
 	         break;
      }
-     delete imageData;	         	         
 }
 
 #endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+// Control points of a patch file: the number of vertices, then x y z for each, sixteen vertices to a patch
+inline std::unique_ptr<glm::vec3[]> loadPatchFile(const std::string& inputFile, int& numberVertices) {
+    std::ifstream file(inputFile.c_str());
+    if (!file.good()) {
+        std::cerr << "Error opening patch file: " << inputFile << std::endl;
+        throw std::exception{};
+    }
+
+    file >> numberVertices;
+
+    auto vertexData = std::unique_ptr<glm::vec3[]>{new glm::vec3[numberVertices]};
+    for (auto i = 0; i < numberVertices; i++) {
+        float x, y, z;
+        file >> x >> y >> z;
+        vertexData[i] = glm::vec3{x, y, z};
+    }
+
+    file.close();
+
+    return vertexData;
+}
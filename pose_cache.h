@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <vector>
+
+#include <assimp/types.h>
+
+#include "skinning.h"
+
+// Top three rows of a row major affine matrix, in the layout of the skinning palette. The last row is always 0 0 0 1.
+struct AffineMatrix {
+    float m[PALETTE_STRIDE];
+
+    AffineMatrix() : m{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0} {}
+
+    explicit AffineMatrix(const aiMatrix4x4& matrix) {
+        std::copy(&matrix.a1, &matrix.a1 + PALETTE_STRIDE, m);
+    }
+};
+
+static_assert(sizeof(AffineMatrix) == PALETTE_STRIDE * sizeof(float), "AffineMatrix must match the palette layout");
+
+// Skinning matrices of every bone for a single tick. Normal matrices are derived from these when the palette is
+// filled, so they are neither baked nor cached.
+struct SkinningPose {
+    std::vector<AffineMatrix> matrix{};
+
+    void resize(int boneCount) {
+        matrix.resize(boneCount);
+    }
+
+    std::size_t bytes() const {
+        return matrix.size() * sizeof(AffineMatrix);
+    }
+};
+
+// Moves every matrix of a pose the given fraction of the way towards the matching matrix of the next pose
+inline void blendPose(SkinningPose& pose, const AffineMatrix* next, float factor) {
+    for (auto b = 0u; b < pose.matrix.size(); b++) {
+        auto matrix = pose.matrix[b].m;
+        const auto nextMatrix = next[b].m;
+        for (auto i = 0; i < PALETTE_STRIDE; i++) {
+            matrix[i] += (nextMatrix[i] - matrix[i]) * factor;
+        }
+    }
+}
+
+// Poses of an animation, either all baked up front or evaluated when first requested and kept in a
+// least recently used cache that never grows past a memory cap
+class PoseCache {
+public:
+    using Evaluator = std::function<void(int tick, SkinningPose& pose)>;
+    // Fills every pose of the animation at once, indexed by tick, instead of calling the evaluator per tick
+    using Baker = std::function<void(std::vector<SkinningPose>& poses)>;
+
+    void reset(int newDuration, int newBoneCount, bool bake, std::size_t maxBytes, Evaluator newEvaluator,
+               const Baker& baker = nullptr) {
+        duration = newDuration;
+        boneCount = newBoneCount;
+        baked = bake;
+        evaluator = std::move(newEvaluator);
+        mappedPoses = nullptr;
+        slots.clear();
+        recent.clear();
+        bakedPoses.clear();
+        tickSlots.assign(duration, -1);
+        hits = 0;
+        misses = 0;
+
+        const auto poseBytes = std::max<std::size_t>(1, boneCount * sizeof(AffineMatrix));
+        capacity = baked ? duration : std::max<std::size_t>(1, std::min<std::size_t>(duration, maxBytes / poseBytes));
+
+        if (baked) {
+            bakedPoses.resize(duration);
+            for (auto& pose : bakedPoses) {
+                pose.resize(boneCount);
+            }
+
+            if (baker) {
+                baker(bakedPoses);
+            } else {
+                for (auto tick = 0; tick < duration; tick++) {
+                    evaluator(tick, bakedPoses[tick]);
+                }
+            }
+        }
+    }
+
+    // Serves every pose straight from poses, boneCount matrices for each tick in turn, which must outlive the cache
+    void map(int newDuration, int newBoneCount, const AffineMatrix* poses) {
+        duration = newDuration;
+        boneCount = newBoneCount;
+        baked = true;
+        capacity = duration;
+        evaluator = nullptr;
+        mappedPoses = poses;
+        slots.clear();
+        recent.clear();
+        bakedPoses.clear();
+        tickSlots.clear();
+        hits = 0;
+        misses = 0;
+    }
+
+    // Skinning matrices of every bone, valid until the next call
+    const AffineMatrix* get(int tick) {
+        if (mappedPoses) {
+            return mappedPoses + std::size_t(tick) * boneCount;
+        }
+        if (baked) {
+            return bakedPoses[tick].matrix.data();
+        }
+
+        auto slot = tickSlots[tick];
+        if (slot >= 0) {
+            hits++;
+            recent.splice(recent.begin(), recent, slots[slot].position);
+            return slots[slot].pose.matrix.data();
+        }
+
+        misses++;
+        if (slots.size() < capacity) {
+            slot = static_cast<int>(slots.size());
+            slots.emplace_back();
+            slots[slot].pose.resize(boneCount);
+            recent.push_front(slot);
+        } else {
+            slot = recent.back();
+            tickSlots[slots[slot].tick] = -1;
+            recent.splice(recent.begin(), recent, std::prev(recent.end()));
+        }
+
+        slots[slot].tick = tick;
+        slots[slot].position = recent.begin();
+        tickSlots[tick] = slot;
+        evaluator(tick, slots[slot].pose);
+        return slots[slot].pose.matrix.data();
+    }
+
+    bool isBaked() const {
+        return baked;
+    }
+
+    std::size_t memoryUsed() const {
+        std::size_t bytes = 0;
+        for (const auto& pose : bakedPoses) {
+            bytes += pose.bytes();
+        }
+        for (const auto& slot : slots) {
+            bytes += slot.pose.bytes();
+        }
+        return bytes;
+    }
+
+    std::size_t getCapacity() const {
+        return capacity;
+    }
+
+    int getHits() const {
+        return hits;
+    }
+
+    int getMisses() const {
+        return misses;
+    }
+
+private:
+    struct Slot {
+        int tick{-1};
+        SkinningPose pose{};
+        std::list<int>::iterator position{};
+    };
+
+    int duration{};
+    int boneCount{};
+    bool baked{true};
+    std::size_t capacity{};
+    Evaluator evaluator{};
+
+    std::vector<SkinningPose> bakedPoses{};
+    // Baked poses owned by someone else, such as a mapped file, used instead of bakedPoses when set
+    const AffineMatrix* mappedPoses{};
+    std::vector<Slot> slots{};
+    // Slot indices, most recently used first
+    std::list<int> recent{};
+    // Slot holding each tick, or -1
+    std::vector<int> tickSlots{};
+    int hits{};
+    int misses{};
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <assimp/scene.h>
+
+#include "compressed_clip.h"
+#include "keyframes.h"
+
+// Drives channels of an animation with channels of a clip recorded on a different skeleton
+struct RetargetMap {
+    // Channel of the animation to the channel of the source clip replacing it
+    std::unordered_map<std::string, std::string> channels{};
+    // Applied after each retargeted channel's transform, correcting for differing bone proportions
+    aiVector3D scale{1};
+    // Channels, of either clip, held at their first key
+    std::unordered_set<std::string> frozen{};
+};
+
+// A channel resolved to the bone it drives and everything needed to sample it, so playback does no name lookups
+struct ChannelBinding {
+    const aiNodeAnim* source;
+    int bone;
+    // Source clip time per tick of the animation
+    double timeScale;
+    bool frozen;
+    bool retargeted;
+    aiMatrix4x4 correction;
+    KeyframeCursor cursor;
+    // Quantized and reduced copy of the source channel, when compression is enabled
+    CompressedChannel compressed;
+};
+
+// Resolves every channel of the animation to a bone index, swapping in channels of the source clip where the map
+// says so. Throws if a channel drives a node missing from the skeleton or the map names a missing source channel.
+inline std::vector<ChannelBinding> compileBindings(const aiAnimation* animation, const aiAnimation* sourceAnimation,
+                                                   const RetargetMap* map,
+                                                   const std::unordered_map<std::string, int>& boneMapping) {
+    std::unordered_map<std::string, const aiNodeAnim*> sourceChannels{};
+    if (map && sourceAnimation) {
+        for (auto i = 0u; i < sourceAnimation->mNumChannels; i++) {
+            sourceChannels.emplace(sourceAnimation->mChannels[i]->mNodeName.C_Str(), sourceAnimation->mChannels[i]);
+        }
+    }
+
+    aiMatrix4x4 correction{};
+    if (map) {
+        aiMatrix4x4::Scaling(map->scale, correction);
+    }
+
+    std::vector<ChannelBinding> bindings{};
+    bindings.reserve(animation->mNumChannels);
+    for (auto i = 0u; i < animation->mNumChannels; i++) {
+        const auto channel = animation->mChannels[i];
+        const auto bone = boneMapping.find(channel->mNodeName.C_Str());
+        if (bone == boneMapping.end()) {
+            throw std::exception{};
+        }
+
+        ChannelBinding binding{channel, bone->second, 1.0, false, false, aiMatrix4x4(), {}, {}};
+        if (map) {
+            const auto remapped = map->channels.find(channel->mNodeName.C_Str());
+            if (remapped != map->channels.end() && sourceAnimation) {
+                const auto source = sourceChannels.find(remapped->second);
+                if (source == sourceChannels.end()) {
+                    throw std::exception{};
+                }
+                binding.source = source->second;
+                binding.timeScale = sourceAnimation->mDuration / animation->mDuration;
+                binding.retargeted = true;
+                binding.correction = correction;
+            }
+            binding.frozen = map->frozen.count(binding.source->mNodeName.C_Str()) > 0;
+        }
+        bindings.push_back(binding);
+    }
+    return bindings;
+}
+
+// Local transform of the binding's bone at the given tick of the animation
+inline aiMatrix4x4 sampleBinding(const ChannelBinding& binding, double time, KeyframeCursor& cursor, bool compressed) {
+    const auto sourceTime = binding.frozen ? 0.0 : time * binding.timeScale;
+    const auto transform = compressed ? binding.compressed.sample(sourceTime, cursor)
+                                      : sampleChannel(binding.source, sourceTime, cursor);
+    return binding.retargeted ? transform * binding.correction : transform;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+#include "retargeting.h"
+
+// Walk cycle of the dwarf driven by the legs of avatar_walk.bvh
+inline const RetargetMap dwarfRetargeting{
+        {
+                {"lhip", "rThigh"},
+                {"rhip", "lThigh"},
+                {"lknee", "rShin"},
+                {"rknee", "lShin"},
+                {"lankle", "rFoot"},
+                {"rankle", "lFoot"},
+                // {"ltoe", "rFoot"},
+                // {"rtoe", "lFoot"},
+        },
+        aiVector3D(1, 0.6, 1),
+        {"middle"},
+};
+
+const int sceneCount = 3;
+
+// Files a scene is imported from and how they are put together, shared by the viewer and the cooker
+struct SceneSource {
+    std::string modelFile;
+    // Empty when the model carries its own animation
+    std::string animationFile;
+    // The mannequin's root motion and root transforms need fixing up after import
+    bool mannequin;
+    const RetargetMap* retargeting;
+
+    // Cooked copy of the scene, next to the model and named after both files
+    std::string cookedFile() const {
+        if (animationFile.empty()) {
+            return modelFile + ".cooked";
+        }
+        const auto lastIndex = animationFile.find_last_of("/\\");
+        return modelFile + "." + animationFile.substr(lastIndex == std::string::npos ? 0 : lastIndex + 1) + ".cooked";
+    }
+
+    std::string directory() const {
+        return modelFile.substr(0, modelFile.find_last_of("/\\") + 1);
+    }
+};
+
+inline SceneSource sceneSource(int sceneId, bool dwarfSpecial) {
+    switch (sceneId) {
+    case 0:
+        return {"data2/ArmyPilot/ArmyPilot.x", "", false, nullptr};
+    case 1:
+        return {"data2/Mannequin/mannequin.fbx", "data2/Mannequin/run.fbx", true, nullptr};
+    case 2:
+        if (dwarfSpecial) {
+            return {"data2/Dwarf/dwarf.x", "data2/Dwarf/avatar_walk.bvh", false, &dwarfRetargeting};
+        }
+        return {"data2/Dwarf/dwarf.x", "", false, nullptr};
+
+    default:
+        throw std::exception{};
+    }
+}
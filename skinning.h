@@ -0,0 +1,555 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SKINNING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SKINNING_TARGET_AVX2
+#else
+#define SKINNING_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// Vertices are processed in blocks of this size, so every SoA array is padded up to a multiple of it
+static constexpr auto SKINNING_BLOCK = 8;
+// Each bone in the palette is stored as the top three rows of its 4x4 matrix
+static constexpr auto PALETTE_STRIDE = 12;
+
+template <typename T, std::size_t Alignment = 32>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {
+    }
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t{Alignment});
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+        return false;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+enum class SkinningPath {
+    Scalar,
+    SSE,
+    AVX2,
+};
+
+// Bone matrices for a single frame, position and normal matrices side by side
+struct SkinningPalette {
+    AlignedVector<float> position{};
+    // Same stride as position so rows stay aligned, the translation column is always zero
+    AlignedVector<float> normal{};
+
+    void resize(int boneCount) {
+        position.assign(boneCount * PALETTE_STRIDE, 0.0f);
+        normal.assign(boneCount * PALETTE_STRIDE, 0.0f);
+    }
+
+    // Matrices are row major 4x4 (such as aiMatrix4x4), the last row is assumed to be 0 0 0 1. The normal matrix is
+    // the inverse transpose of the upper 3x3, which is its cofactor matrix over its determinant, so it is exact under
+    // non-uniform scale without a full 4x4 inverse. For a pure rotation it is the rotation itself.
+    void setBone(int bone, const float* positionMatrix) {
+        const auto m = &position[bone * PALETTE_STRIDE];
+        std::memcpy(m, positionMatrix, sizeof(float) * PALETTE_STRIDE);
+
+        const auto n = &normal[bone * PALETTE_STRIDE];
+        n[0] = m[5] * m[10] - m[6] * m[9];
+        n[1] = m[6] * m[8] - m[4] * m[10];
+        n[2] = m[4] * m[9] - m[5] * m[8];
+        n[4] = m[2] * m[9] - m[1] * m[10];
+        n[5] = m[0] * m[10] - m[2] * m[8];
+        n[6] = m[1] * m[8] - m[0] * m[9];
+        n[8] = m[1] * m[6] - m[2] * m[5];
+        n[9] = m[2] * m[4] - m[0] * m[6];
+        n[10] = m[0] * m[5] - m[1] * m[4];
+        n[3] = n[7] = n[11] = 0;
+
+        // A degenerate bone keeps its unscaled cofactors, which still point normals the right way
+        const auto determinant = m[0] * n[0] + m[1] * n[1] + m[2] * n[2];
+        if (std::abs(determinant) > 1e-12f) {
+            const auto inverse = 1 / determinant;
+            for (auto i : {0, 1, 2, 4, 5, 6, 8, 9, 10}) {
+                n[i] *= inverse;
+            }
+        }
+    }
+};
+
+// Number of vertices to allocate so a mesh of the given size fills whole blocks
+inline int paddedVertexCount(int vertexCount) {
+    return (vertexCount + SKINNING_BLOCK - 1) / SKINNING_BLOCK * SKINNING_BLOCK;
+}
+
+static constexpr auto MAX_INFLUENCES = 4;
+static constexpr auto WEIGHT_ONE = 65535;
+
+// Up to four bone influences of a vertex, weights are unorm16 and sum to exactly WEIGHT_ONE
+// Unused slots have a weight of zero against bone 0, so they add nothing
+struct alignas(16) VertexWeights {
+    uint16_t bones[MAX_INFLUENCES];
+    uint16_t weights[MAX_INFLUENCES];
+};
+
+static_assert(sizeof(VertexWeights) == 16, "VertexWeights must stay 16 bytes");
+
+// Collects the strongest influences of a single vertex while the bones of a mesh are walked
+struct InfluenceAccumulator {
+    int bones[MAX_INFLUENCES]{};
+    float weights[MAX_INFLUENCES]{};
+    int count{};
+    // Sum of every weight seen, including pruned ones
+    float total{};
+
+    void add(int bone, float weight) {
+        total += weight;
+        if (count < MAX_INFLUENCES) {
+            bones[count] = bone;
+            weights[count] = weight;
+            count++;
+            return;
+        }
+
+        auto smallest = 0;
+        for (auto k = 1; k < MAX_INFLUENCES; k++) {
+            if (weights[k] < weights[smallest]) {
+                smallest = k;
+            }
+        }
+        if (weight > weights[smallest]) {
+            bones[smallest] = bone;
+            weights[smallest] = weight;
+        }
+    }
+
+    // Renormalises the kept influences to unorm16, returns the L1 distance to the normalised unpruned weights
+    float pack(VertexWeights& out) const {
+        out = {};
+        auto kept = 0.0f;
+        for (auto k = 0; k < count; k++) {
+            kept += weights[k];
+        }
+        if (kept <= 0) {
+            return 0;
+        }
+
+        auto sum = 0;
+        auto largest = 0;
+        for (auto k = 0; k < count; k++) {
+            out.bones[k] = static_cast<uint16_t>(bones[k]);
+            out.weights[k] = static_cast<uint16_t>(std::lround(weights[k] / kept * WEIGHT_ONE));
+            sum += out.weights[k];
+            if (weights[k] > weights[largest]) {
+                largest = k;
+            }
+        }
+        out.weights[largest] = static_cast<uint16_t>(out.weights[largest] + WEIGHT_ONE - sum);
+
+        auto error = (total - kept) / total;
+        for (auto k = 0; k < count; k++) {
+            error += std::abs(weights[k] / total - out.weights[k] / float(WEIGHT_ONE));
+        }
+        return error;
+    }
+};
+
+// Bind pose vertices of a single mesh in SoA form
+struct SkinningInput {
+    int vertexCount{};
+    int paddedCount{};
+    bool hasNormals{};
+
+    AlignedVector<float> positionX{};
+    AlignedVector<float> positionY{};
+    AlignedVector<float> positionZ{};
+    AlignedVector<float> normalX{};
+    AlignedVector<float> normalY{};
+    AlignedVector<float> normalZ{};
+    // Not owned, must hold paddedCount entries
+    const VertexWeights* weights{};
+
+    void resize(int newVertexCount, bool normals) {
+        vertexCount = newVertexCount;
+        paddedCount = paddedVertexCount(newVertexCount);
+        hasNormals = normals;
+
+        positionX.assign(paddedCount, 0.0f);
+        positionY.assign(paddedCount, 0.0f);
+        positionZ.assign(paddedCount, 0.0f);
+        normalX.assign(hasNormals ? paddedCount : 0, 0.0f);
+        normalY.assign(hasNormals ? paddedCount : 0, 0.0f);
+        normalZ.assign(hasNormals ? paddedCount : 0, 0.0f);
+    }
+};
+
+struct SkinningOutput {
+    AlignedVector<float> positionX{};
+    AlignedVector<float> positionY{};
+    AlignedVector<float> positionZ{};
+    AlignedVector<float> normalX{};
+    AlignedVector<float> normalY{};
+    AlignedVector<float> normalZ{};
+
+    void resize(const SkinningInput& input) {
+        positionX.resize(input.paddedCount);
+        positionY.resize(input.paddedCount);
+        positionZ.resize(input.paddedCount);
+        normalX.resize(input.hasNormals ? input.paddedCount : 0);
+        normalY.resize(input.hasNormals ? input.paddedCount : 0);
+        normalZ.resize(input.hasNormals ? input.paddedCount : 0);
+    }
+};
+
+// Reference implementation, same arithmetic as the original per vertex aiMatrix4x4 loop
+inline void skinVerticesScalar(const SkinningPalette& palette, const SkinningInput& input, SkinningOutput& output) {
+    for (auto v = 0; v < input.vertexCount; v++) {
+        float px = 0, py = 0, pz = 0;
+        float nx = 0, ny = 0, nz = 0;
+
+        const auto& weights = input.weights[v];
+        for (auto k = 0; k < MAX_INFLUENCES; k++) {
+            const auto bone = weights.bones[k];
+            const auto weight = weights.weights[k] * (1.0f / WEIGHT_ONE);
+            const auto m = &palette.position[bone * PALETTE_STRIDE];
+
+            const auto x = input.positionX[v];
+            const auto y = input.positionY[v];
+            const auto z = input.positionZ[v];
+            px += (m[0] * x + m[1] * y + m[2] * z + m[3]) * weight;
+            py += (m[4] * x + m[5] * y + m[6] * z + m[7]) * weight;
+            pz += (m[8] * x + m[9] * y + m[10] * z + m[11]) * weight;
+
+            if (input.hasNormals) {
+                const auto n = &palette.normal[bone * PALETTE_STRIDE];
+                const auto x = input.normalX[v];
+                const auto y = input.normalY[v];
+                const auto z = input.normalZ[v];
+                nx += (n[0] * x + n[1] * y + n[2] * z) * weight;
+                ny += (n[4] * x + n[5] * y + n[6] * z) * weight;
+                nz += (n[8] * x + n[9] * y + n[10] * z) * weight;
+            }
+        }
+
+        output.positionX[v] = px;
+        output.positionY[v] = py;
+        output.positionZ[v] = pz;
+        if (input.hasNormals) {
+            output.normalX[v] = nx;
+            output.normalY[v] = ny;
+            output.normalZ[v] = nz;
+        }
+    }
+}
+
+#if defined(SKINNING_X86)
+// Loads the 3x4 matrices of four bones and transposes them so each register holds one element for all four lanes
+inline void loadPaletteSse(const float* palette, const int32_t* bones, __m128 m[12]) {
+    for (auto row = 0; row < 3; row++) {
+        auto r0 = _mm_load_ps(palette + bones[0] * PALETTE_STRIDE + row * 4);
+        auto r1 = _mm_load_ps(palette + bones[1] * PALETTE_STRIDE + row * 4);
+        auto r2 = _mm_load_ps(palette + bones[2] * PALETTE_STRIDE + row * 4);
+        auto r3 = _mm_load_ps(palette + bones[3] * PALETTE_STRIDE + row * 4);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        m[row * 4 + 0] = r0;
+        m[row * 4 + 1] = r1;
+        m[row * 4 + 2] = r2;
+        m[row * 4 + 3] = r3;
+    }
+}
+
+// Transposes 16 bit values of four vertices, so each output holds one influence slot for all four as 32 bit integers
+inline void transposeInfluencesSse(__m128i v01, __m128i v23, __m128i out[MAX_INFLUENCES]) {
+    const auto zero = _mm_setzero_si128();
+    const auto u0 = _mm_unpacklo_epi16(v01, v23);
+    const auto u1 = _mm_unpackhi_epi16(v01, v23);
+    const auto s0 = _mm_unpacklo_epi16(u0, u1);
+    const auto s1 = _mm_unpackhi_epi16(u0, u1);
+    out[0] = _mm_unpacklo_epi16(s0, zero);
+    out[1] = _mm_unpackhi_epi16(s0, zero);
+    out[2] = _mm_unpacklo_epi16(s1, zero);
+    out[3] = _mm_unpackhi_epi16(s1, zero);
+}
+
+inline void loadWeightsSse(const VertexWeights* weights, __m128i bones[MAX_INFLUENCES], __m128 values[MAX_INFLUENCES]) {
+    const auto r0 = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + 0));
+    const auto r1 = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + 1));
+    const auto r2 = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + 2));
+    const auto r3 = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + 3));
+
+    transposeInfluencesSse(_mm_unpacklo_epi64(r0, r1), _mm_unpacklo_epi64(r2, r3), bones);
+
+    __m128i integerValues[MAX_INFLUENCES];
+    transposeInfluencesSse(_mm_unpackhi_epi64(r0, r1), _mm_unpackhi_epi64(r2, r3), integerValues);
+    const auto scale = _mm_set1_ps(1.0f / WEIGHT_ONE);
+    for (auto k = 0; k < MAX_INFLUENCES; k++) {
+        values[k] = _mm_mul_ps(_mm_cvtepi32_ps(integerValues[k]), scale);
+    }
+}
+
+inline void skinVerticesSse(const SkinningPalette& palette, const SkinningInput& input, SkinningOutput& output) {
+    __m128 m[12];
+
+    for (auto v = 0; v < input.paddedCount; v += 4) {
+        const auto x = _mm_load_ps(&input.positionX[v]);
+        const auto y = _mm_load_ps(&input.positionY[v]);
+        const auto z = _mm_load_ps(&input.positionZ[v]);
+        auto px = _mm_setzero_ps();
+        auto py = _mm_setzero_ps();
+        auto pz = _mm_setzero_ps();
+
+        auto nx = _mm_setzero_ps();
+        auto ny = _mm_setzero_ps();
+        auto nz = _mm_setzero_ps();
+
+        __m128i slotBones[MAX_INFLUENCES];
+        __m128 slotWeights[MAX_INFLUENCES];
+        loadWeightsSse(&input.weights[v], slotBones, slotWeights);
+
+        for (auto k = 0; k < MAX_INFLUENCES; k++) {
+            alignas(16) int32_t bones[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(bones), slotBones[k]);
+            const auto weight = slotWeights[k];
+
+            loadPaletteSse(palette.position.data(), bones, m);
+            auto tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_add_ps(_mm_mul_ps(m[2], z), m[3]));
+            auto ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)), _mm_add_ps(_mm_mul_ps(m[6], z), m[7]));
+            auto tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)), _mm_add_ps(_mm_mul_ps(m[10], z), m[11]));
+            px = _mm_add_ps(px, _mm_mul_ps(tx, weight));
+            py = _mm_add_ps(py, _mm_mul_ps(ty, weight));
+            pz = _mm_add_ps(pz, _mm_mul_ps(tz, weight));
+
+            if (input.hasNormals) {
+                const auto inx = _mm_load_ps(&input.normalX[v]);
+                const auto iny = _mm_load_ps(&input.normalY[v]);
+                const auto inz = _mm_load_ps(&input.normalZ[v]);
+
+                loadPaletteSse(palette.normal.data(), bones, m);
+                tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], inx), _mm_mul_ps(m[1], iny)), _mm_mul_ps(m[2], inz));
+                ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], inx), _mm_mul_ps(m[5], iny)), _mm_mul_ps(m[6], inz));
+                tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], inx), _mm_mul_ps(m[9], iny)), _mm_mul_ps(m[10], inz));
+                nx = _mm_add_ps(nx, _mm_mul_ps(tx, weight));
+                ny = _mm_add_ps(ny, _mm_mul_ps(ty, weight));
+                nz = _mm_add_ps(nz, _mm_mul_ps(tz, weight));
+            }
+        }
+
+        _mm_store_ps(&output.positionX[v], px);
+        _mm_store_ps(&output.positionY[v], py);
+        _mm_store_ps(&output.positionZ[v], pz);
+        if (input.hasNormals) {
+            _mm_store_ps(&output.normalX[v], nx);
+            _mm_store_ps(&output.normalY[v], ny);
+            _mm_store_ps(&output.normalZ[v], nz);
+        }
+    }
+}
+
+SKINNING_TARGET_AVX2 inline void transformAvx2(const float* palette, __m256i offset, __m256 x, __m256 y, __m256 z, __m256 weight,
+                                               __m256& outX, __m256& outY, __m256& outZ) {
+    __m256 m[PALETTE_STRIDE];
+    for (auto element = 0; element < PALETTE_STRIDE; element++) {
+        m[element] = _mm256_i32gather_ps(palette + element, offset, 4);
+    }
+
+    const auto tx = _mm256_fmadd_ps(m[0], x, _mm256_fmadd_ps(m[1], y, _mm256_fmadd_ps(m[2], z, m[3])));
+    const auto ty = _mm256_fmadd_ps(m[4], x, _mm256_fmadd_ps(m[5], y, _mm256_fmadd_ps(m[6], z, m[7])));
+    const auto tz = _mm256_fmadd_ps(m[8], x, _mm256_fmadd_ps(m[9], y, _mm256_fmadd_ps(m[10], z, m[11])));
+    outX = _mm256_fmadd_ps(tx, weight, outX);
+    outY = _mm256_fmadd_ps(ty, weight, outY);
+    outZ = _mm256_fmadd_ps(tz, weight, outZ);
+}
+
+// Normal matrices have no translation, so only their 3x3 part is gathered
+SKINNING_TARGET_AVX2 inline void transformNormalAvx2(const float* palette, __m256i offset, __m256 x, __m256 y, __m256 z, __m256 weight,
+                                                     __m256& outX, __m256& outY, __m256& outZ) {
+    __m256 m[PALETTE_STRIDE];
+    for (auto element : {0, 1, 2, 4, 5, 6, 8, 9, 10}) {
+        m[element] = _mm256_i32gather_ps(palette + element, offset, 4);
+    }
+
+    const auto tx = _mm256_fmadd_ps(m[0], x, _mm256_fmadd_ps(m[1], y, _mm256_mul_ps(m[2], z)));
+    const auto ty = _mm256_fmadd_ps(m[4], x, _mm256_fmadd_ps(m[5], y, _mm256_mul_ps(m[6], z)));
+    const auto tz = _mm256_fmadd_ps(m[8], x, _mm256_fmadd_ps(m[9], y, _mm256_mul_ps(m[10], z)));
+    outX = _mm256_fmadd_ps(tx, weight, outX);
+    outY = _mm256_fmadd_ps(ty, weight, outY);
+    outZ = _mm256_fmadd_ps(tz, weight, outZ);
+}
+
+SKINNING_TARGET_AVX2 inline void skinVerticesAvx2(const SkinningPalette& palette, const SkinningInput& input, SkinningOutput& output) {
+    const auto stride = _mm256_set1_epi32(PALETTE_STRIDE);
+
+    for (auto v = 0; v < input.paddedCount; v += 8) {
+        const auto x = _mm256_load_ps(&input.positionX[v]);
+        const auto y = _mm256_load_ps(&input.positionY[v]);
+        const auto z = _mm256_load_ps(&input.positionZ[v]);
+        auto px = _mm256_setzero_ps();
+        auto py = _mm256_setzero_ps();
+        auto pz = _mm256_setzero_ps();
+
+        auto nx = _mm256_setzero_ps();
+        auto ny = _mm256_setzero_ps();
+        auto nz = _mm256_setzero_ps();
+
+        __m128i lowBones[MAX_INFLUENCES], highBones[MAX_INFLUENCES];
+        __m128 lowWeights[MAX_INFLUENCES], highWeights[MAX_INFLUENCES];
+        loadWeightsSse(&input.weights[v], lowBones, lowWeights);
+        loadWeightsSse(&input.weights[v + 4], highBones, highWeights);
+
+        for (auto k = 0; k < MAX_INFLUENCES; k++) {
+            const auto bones = _mm256_set_m128i(highBones[k], lowBones[k]);
+            const auto offset = _mm256_mullo_epi32(bones, stride);
+            const auto weight = _mm256_set_m128(highWeights[k], lowWeights[k]);
+
+            transformAvx2(palette.position.data(), offset, x, y, z, weight, px, py, pz);
+
+            if (input.hasNormals) {
+                transformNormalAvx2(palette.normal.data(), offset,
+                                    _mm256_load_ps(&input.normalX[v]),
+                                    _mm256_load_ps(&input.normalY[v]),
+                                    _mm256_load_ps(&input.normalZ[v]),
+                                    weight, nx, ny, nz);
+            }
+        }
+
+        _mm256_store_ps(&output.positionX[v], px);
+        _mm256_store_ps(&output.positionY[v], py);
+        _mm256_store_ps(&output.positionZ[v], pz);
+        if (input.hasNormals) {
+            _mm256_store_ps(&output.normalX[v], nx);
+            _mm256_store_ps(&output.normalY[v], ny);
+            _mm256_store_ps(&output.normalZ[v], nz);
+        }
+    }
+}
+
+inline bool cpuSupportsAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const auto fma = (info[2] & (1 << 12)) != 0;
+    const auto osxsave = (info[2] & (1 << 27)) != 0;
+    __cpuidex(info, 7, 0);
+    const auto avx2 = (info[1] & (1 << 5)) != 0;
+    return fma && osxsave && avx2 && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+inline bool skinningPathSupported(SkinningPath path) {
+    switch (path) {
+    case SkinningPath::Scalar:
+        return true;
+#if defined(SKINNING_X86)
+    case SkinningPath::SSE:
+        return true;
+    case SkinningPath::AVX2:
+        return cpuSupportsAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+inline SkinningPath bestSkinningPath() {
+    if (skinningPathSupported(SkinningPath::AVX2)) {
+        return SkinningPath::AVX2;
+    }
+    if (skinningPathSupported(SkinningPath::SSE)) {
+        return SkinningPath::SSE;
+    }
+    return SkinningPath::Scalar;
+}
+
+inline const char* skinningPathName(SkinningPath path) {
+    switch (path) {
+    case SkinningPath::Scalar:
+        return "Scalar";
+    case SkinningPath::SSE:
+        return "SSE";
+    case SkinningPath::AVX2:
+        return "AVX2";
+    }
+    return "Unknown";
+}
+
+inline void skinVertices(SkinningPath path, const SkinningPalette& palette, const SkinningInput& input, SkinningOutput& output) {
+    switch (path) {
+#if defined(SKINNING_X86)
+    case SkinningPath::AVX2:
+        skinVerticesAvx2(palette, input, output);
+        break;
+    case SkinningPath::SSE:
+        skinVerticesSse(palette, input, output);
+        break;
+#endif
+    default:
+        skinVerticesScalar(palette, input, output);
+        break;
+    }
+}
+
+// Largest absolute component difference between two outputs, used to check the SIMD paths against the reference
+inline float skinningError(const SkinningInput& input, const SkinningOutput& a, const SkinningOutput& b) {
+    auto error = 0.0f;
+    for (auto v = 0; v < input.vertexCount; v++) {
+        error = std::max(error, std::abs(a.positionX[v] - b.positionX[v]));
+        error = std::max(error, std::abs(a.positionY[v] - b.positionY[v]));
+        error = std::max(error, std::abs(a.positionZ[v] - b.positionZ[v]));
+        if (input.hasNormals) {
+            error = std::max(error, std::abs(a.normalX[v] - b.normalX[v]));
+            error = std::max(error, std::abs(a.normalY[v] - b.normalY[v]));
+            error = std::max(error, std::abs(a.normalZ[v] - b.normalZ[v]));
+        }
+    }
+    return error;
+}
+
+// Vertices per second for the given path, averaged over a number of runs
+inline double measureSkinning(SkinningPath path, const SkinningPalette& palette, const SkinningInput& input, SkinningOutput& output,
+                              int iterations) {
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < iterations; i++) {
+        skinVertices(path, palette, input, output);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() > 0 ? double(input.vertexCount) * iterations / elapsed.count() : 0.0;
+}
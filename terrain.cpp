@@ -4,8 +4,12 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "headless.h"
 #include "model.h"
 #include "shader.h"
+#include "terrain_grid.h"
+#include "terrain_quadtree.h"
+#include "terrain_streaming.h"
 #include "texture.h"
 
 bool keyState[256] = {};
@@ -14,50 +18,96 @@ int oldTimeSinceStart{};
 
 std::unique_ptr<Scene> scene;
 bool wireframeMode{false};
+// Tiled world to stream instead of the single heightmap, from --world
+std::string worldFile{};
+// Start with the geometry shader's flat normals rather than smooth ones, from --flat
+bool flatShading{false};
 
-class Terrain : public Model {
+// Water and snow lines, shared by both ways of drawing the terrain
+class TerrainModel : public Model {
+public:
+    virtual void updateKeyboard(unsigned char key) {
+        if (key == 'v') {
+            waterHeight -= 0.1;
+            if (waterHeight < 0) {
+                waterHeight = 0;
+            }
+        }
+        if (key == 'b') {
+            waterHeight += 0.1;
+            if (waterHeight > 7) {
+                waterHeight = 7;
+            }
+        }
+
+        if (key == 'n') {
+            snowHeight -= 0.1;
+            if (snowHeight < 5) {
+                snowHeight = 5;
+            }
+        }
+        if (key == 'm') {
+            snowHeight += 0.1;
+            if (snowHeight > 10) {
+                snowHeight = 10;
+            }
+        }
+    }
+
+protected:
+    float waterHeight{2};
+    float snowHeight{7};
+};
+
+class Terrain : public TerrainModel {
 public:
     explicit Terrain(const Scene& scene) {
+        // Normals from the heightmap in the evaluation shader, or per face in a geometry shader for comparison
         shader = std::make_unique<Shader>("data/terrain.vert",
+                "data/terrain.tesc",
+                "data/terrain_smooth.tese",
+                "data/terrain.frag");
+        flatShader = std::make_unique<Shader>("data/terrain.vert",
                 "data/terrain.tesc",
                 "data/terrain.tese",
                 "data/terrain.geom",
                 "data/terrain.frag");
+        // Water is one quad over the whole terrain, the patches beneath it left undrawn
+        waterShader = std::make_unique<Shader>("data/water.vert", "data/water.frag");
 
         heightMap1 = std::make_unique<Texture>("data/HeightMap1.tga");
         heightMap2 = std::make_unique<Texture>("data/HeightMap2.png");
+        for (const std::string filePath : {"data/HeightMap1.tga", "data/HeightMap2.png"}) {
+            const auto field = loadHeightField(filePath, HEIGHT_SCALE);
+            const auto roughness = buildRoughnessMap(field, ROUGHNESS_BLOCK_SIZE);
+            roughnessMaps.push_back(std::make_unique<Texture>(roughness.width, roughness.height, GL_R32F, GL_RED,
+                    GL_FLOAT, roughness.roughness.data()));
+
+            // Raw heights, so moving the water needs nothing rebuilt; the shader measures relief above it
+            const auto bounds = buildHeightBounds(field);
+            auto boundsTexture = std::make_unique<Texture>(field.width, field.height, static_cast<int>(bounds.size()),
+                    GL_RG32F);
+            for (auto level = 0; level < static_cast<int>(bounds.size()); level++) {
+                boundsTexture->upload(level, bounds[level].width, bounds[level].height, GL_RG, GL_FLOAT,
+                        bounds[level].bounds.data());
+            }
+            heightBounds.push_back(std::move(boundsTexture));
+            quadtrees.push_back(std::make_unique<TerrainQuadtree>(field, roughness, GRID_SIZE, SIZE));
+        }
 
         waterTexture = std::make_unique<Texture>("data/Water.png");
         grassTexture = std::make_unique<Texture>("data/Grass.jpg");
         snowTexture = std::make_unique<Texture>("data/Snow.jpg");
 
         // Create a grid of vertices from -SIZE to SIZE in both x and z
-        glm::vec4 VERTEX_DATA[TOTAL_VERTICES]{};
-        uint32_t INDEX_DATA[TOTAL_INDICES]{};
-
-        for (auto y = 0; y < GRID_SIZE + 1; y++) {
-            for (auto x = 0; x < GRID_SIZE + 1; x++) {
-                VERTEX_DATA[y * (GRID_SIZE + 1) + x] = glm::vec4{
-                        ((x * 2.0f) / GRID_SIZE - 1.0f) * SIZE,
-                        ((y * 2.0f) / GRID_SIZE - 1.0f) * SIZE,
-                        (float)x / GRID_SIZE,
-                        1 - (float)y / GRID_SIZE
-                };
-            }
-        }
-
-        for (auto y = 0; y < GRID_SIZE; y++) {
-            for (auto x = 0; x < GRID_SIZE; x++) {
-                INDEX_DATA[(y * GRID_SIZE + x) * 4 + 0] = y * (GRID_SIZE + 1) + x;
-                INDEX_DATA[(y * GRID_SIZE + x) * 4 + 1] = (y + 1) * (GRID_SIZE + 1) + x;
-                INDEX_DATA[(y * GRID_SIZE + x) * 4 + 2] = (y + 1) * (GRID_SIZE + 1) + (x + 1);
-                INDEX_DATA[(y * GRID_SIZE + x) * 4 + 3] = y * (GRID_SIZE + 1) + (x + 1);
-            }
-        }
+        const auto grid = buildTerrainGrid(GRID_SIZE, SIZE);
 
-        // Send buffer data to GPU
-        glNamedBufferStorage(buffers[VERTEX_BUFFER], sizeof(VERTEX_DATA), VERTEX_DATA, 0);
-        glNamedBufferStorage(buffers[INDEX_BUFFER], sizeof(INDEX_DATA), INDEX_DATA, 0);
+        // Send buffer data to GPU, the indices are rewritten with the visible patches every frame
+        glNamedBufferStorage(buffers[VERTEX_BUFFER], grid.vertices.size() * sizeof(glm::vec4), grid.vertices.data(), 0);
+        glNamedBufferStorage(buffers[INDEX_BUFFER], grid.indices.size() * sizeof(uint32_t), grid.indices.data(), GL_DYNAMIC_STORAGE_BIT);
+        allIndices = grid.indices;
+        uploadedIndices = grid.indices;
+        visibleIndices.reserve(allIndices.size());
 
         // Setup vertex attributes
         glEnableVertexArrayAttrib(vertexArray, 0);
@@ -69,14 +119,20 @@ public:
         glVertexArrayElementBuffer(vertexArray, buffers[INDEX_BUFFER]);
 
         // Setup uniform blocks
-        GLuint sceneInputDataIndex = glGetUniformBlockIndex(shader->program, "SceneInputData");
-        glUniformBlockBinding(shader->program, sceneInputDataIndex, 0);
+        for (const auto program : {shader->program, flatShader->program, waterShader->program}) {
+            GLuint sceneInputDataIndex = glGetUniformBlockIndex(program, "SceneInputData");
+            glUniformBlockBinding(program, sceneInputDataIndex, 0);
+        }
         glBindBufferBase(GL_UNIFORM_BUFFER, 0, scene.getSceneUniformBuffer());
+
+        glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &primitivesQuery);
     }
 
-    ~Terrain() override = default;
+    ~Terrain() override {
+        glDeleteQueries(1, &primitivesQuery);
+    }
 
-    void updateKeyboard(unsigned char key) {
+    void updateKeyboard(unsigned char key) override {
         if (key == '1') {
             heightMap = 0;
         }
@@ -84,40 +140,63 @@ public:
             heightMap = 1;
         }
 
-        if (key == 'v') {
-            waterHeight -= 0.1;
-            if (waterHeight < 0) {
-                waterHeight = 0;
-            }
+        if (key == 'c') {
+            culling = !culling;
+            std::cout << "Quadtree culling " << (culling ? "on" : "off") << std::endl;
         }
-        if (key == 'b') {
-            waterHeight += 0.1;
-            if (waterHeight > 7) {
-                waterHeight = 7;
-            }
+
+        if (key == '[' || key == ']') {
+            detail.pixelsPerTriangle = key == '[' ? std::max(detail.pixelsPerTriangle / 2, 1.0f)
+                                                  : std::min(detail.pixelsPerTriangle * 2, 64.0f);
+            std::cout << "Target of " << detail.pixelsPerTriangle << " pixels per triangle edge" << std::endl;
         }
 
-        if (key == 'n') {
-            snowHeight -= 0.1;
-            if (snowHeight < 5) {
-                snowHeight = 5;
-            }
+        if (key == 'f') {
+            flatShading = !flatShading;
+            std::cout << (flatShading ? "Flat" : "Smooth") << " shading" << std::endl;
         }
-        if (key == 'm') {
-            snowHeight += 0.1;
-            if (snowHeight > 10) {
-                snowHeight = 10;
-            }
+
+        if (key == 'p') {
+            std::cout << "Last counted frame drew " << triangleCount << " triangles" << std::endl;
         }
+
+        TerrainModel::updateKeyboard(key);
     }
 
     void update(float) override {
     }
 
     void render(const Scene& scene) override {
+        // Water first, so the depth test rejects the ground beneath it before shading
+        glBindVertexArray(vertexArray);
+        glUseProgram(waterShader->program);
+        waterTexture->bind(3);
+        glUniform1f(glGetUniformLocation(waterShader->program, "waterHeight"), waterHeight);
+        glUniform1f(glGetUniformLocation(waterShader->program, "size"), SIZE);
+        glUniform1f(glGetUniformLocation(waterShader->program, "textureScale"), GRID_SIZE);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        // Only the patches in view, distant ground merged into fewer larger ones
+        const auto& indices = culling ? visibleIndices : allIndices;
+        if (culling) {
+            const auto& camera = scene.getCamera();
+            visibleIndices.clear();
+            quadtrees[heightMap]->select(Frustum{camera.getProjectionView()}, camera.getCameraPosition(), detail,
+                    waterHeight, visibleIndices);
+        }
+        if (indices.empty()) {
+            return;
+        }
+        // Only when they change, which a still camera or culling turned off never does
+        if (indices != uploadedIndices) {
+            glNamedBufferSubData(buffers[INDEX_BUFFER], 0, indices.size() * sizeof(uint32_t), indices.data());
+            uploadedIndices = indices;
+        }
+
         glPatchParameteri(GL_PATCH_VERTICES, 4);
         glBindVertexArray(vertexArray);
-        glUseProgram(shader->program);
+        const auto program = flatShading ? flatShader->program : shader->program;
+        glUseProgram(program);
         if (heightMap == 0) {
             heightMap1->bind(0);
         } else {
@@ -126,25 +205,208 @@ public:
         grassTexture->bind(1);
         snowTexture->bind(2);
         waterTexture->bind(3);
-        glUniform1f(glGetUniformLocation(shader->program, "waterHeight"), waterHeight);
-        glUniform1f(glGetUniformLocation(shader->program, "snowHeight"), snowHeight);
-        glDrawElements(GL_PATCHES, TOTAL_INDICES, GL_UNSIGNED_INT, nullptr);
+        roughnessMaps[heightMap]->bind(4);
+        heightBounds[heightMap]->bind(5);
+        glUniform1f(glGetUniformLocation(program, "waterHeight"), waterHeight);
+        glUniform1f(glGetUniformLocation(program, "snowHeight"), snowHeight);
+        glUniform1f(glGetUniformLocation(program, "patchSize"), 2 * SIZE / GRID_SIZE);
+        glUniform1f(glGetUniformLocation(program, "pixelScale"), detail.pixelScale);
+        glUniform1f(glGetUniformLocation(program, "pixelsPerTriangle"), detail.pixelsPerTriangle);
+        glUniform1f(glGetUniformLocation(program, "roughnessScale"), detail.roughnessScale);
+        glUniform1f(glGetUniformLocation(program, "minimumDetail"), detail.minimumDetail);
+        glUniform1f(glGetUniformLocation(program, "terrainSize"), 2 * SIZE);
+        glUniform1f(glGetUniformLocation(program, "flatHeight"), FLAT_HEIGHT);
+
+        // Read back only once the GPU has the result and only then counted again, so counting never makes the CPU wait
+        if (queryPending) {
+            GLint available{};
+            glGetQueryObjectiv(primitivesQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 primitives{};
+                glGetQueryObjectui64v(primitivesQuery, GL_QUERY_RESULT, &primitives);
+                triangleCount = primitives;
+                queryPending = false;
+            }
+        }
+        if (queryPending) {
+            glDrawElements(GL_PATCHES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, nullptr);
+        } else {
+            glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
+            glDrawElements(GL_PATCHES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, nullptr);
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+            queryPending = true;
+        }
     }
 
 private:
     static constexpr auto GRID_SIZE = 9;
     static constexpr auto SIZE = 50.0f;
-    static constexpr auto TOTAL_INDICES = GRID_SIZE * GRID_SIZE * 4;
-    static constexpr auto TOTAL_VERTICES = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+    static constexpr auto HEIGHT_SCALE = 10.0f;
+    static constexpr auto ROUGHNESS_BLOCK_SIZE = 8;
+    // Relief drawn as a single quad, about a step of an 8 bit heightmap
+    static constexpr auto FLAT_HEIGHT = 0.05f;
 
+    std::unique_ptr<Shader> flatShader{};
+    std::unique_ptr<Shader> waterShader{};
     std::unique_ptr<Texture> heightMap1{};
     std::unique_ptr<Texture> heightMap2{};
+    // One of each per heightmap
+    std::vector<std::unique_ptr<Texture>> roughnessMaps{};
+    std::vector<std::unique_ptr<Texture>> heightBounds{};
+    std::vector<std::unique_ptr<TerrainQuadtree>> quadtrees{};
     std::unique_ptr<Texture> waterTexture{};
     std::unique_ptr<Texture> grassTexture{};
     std::unique_ptr<Texture> snowTexture{};
-    float waterHeight{2};
-    float snowHeight{7};
     int heightMap{0};
+    bool culling{true};
+    std::vector<uint32_t> allIndices{};
+    std::vector<uint32_t> visibleIndices{};
+    // What the index buffer holds
+    std::vector<uint32_t> uploadedIndices{};
+
+    // The camera's 60 degree field of view over the 600 pixel high window. Ground with a fifth of a unit of
+    // roughness in each block gets the full projected level, flat ground a twentieth of it.
+    TessellationDetail detail{300 / std::tan(30 * DEGREE_TO_RADIAN), 12, 0.2f, 0.05f};
+    GLuint primitivesQuery{};
+    bool queryPending{false};
+    GLuint64 triangleCount{};
+};
+
+// Streams a tiled world through a fixed cache of tiles. The tiles form a quadtree, each drawn as a chunk of patches:
+// a tile is split into its four children while the camera is within LOD_RANGE of its size, once all four are
+// resident, so distant ground is drawn from coarse tiles and ground still loading from the tile above it.
+class ChunkedTerrain : public TerrainModel {
+public:
+    ChunkedTerrain(const Scene& scene, const std::string& fileName)
+            : tiles(fileName, SLOT_COUNT, UPLOADS_PER_FRAME, MAXIMUM_LOADING) {
+        shader = std::make_unique<Shader>("data/terrain_chunk.vert",
+                "data/terrain_chunk.tesc",
+                "data/terrain_chunk.tese",
+                "data/terrain.geom",
+                "data/terrain.frag");
+
+        waterTexture = std::make_unique<Texture>("data/Water.png");
+        grassTexture = std::make_unique<Texture>("data/Grass.jpg");
+        snowTexture = std::make_unique<Texture>("data/Snow.jpg");
+
+        const auto& header = tiles.getHeader();
+        worldSize = header.tilesAcross * header.tileSize * header.sampleSpacing;
+
+        // Every chunk shares one grid over the unit square, reaching a patch further on each side for its skirt
+        const auto grid = buildTerrainGrid(CHUNK_GRID_SIZE + 2, 0.5f * (CHUNK_GRID_SIZE + 2) / CHUNK_GRID_SIZE);
+        indexCount = static_cast<int>(grid.indices.size());
+
+        // Send buffer data to GPU, the chunks are rewritten every frame
+        glNamedBufferStorage(buffers[VERTEX_BUFFER], grid.vertices.size() * sizeof(glm::vec4), grid.vertices.data(), 0);
+        glNamedBufferStorage(buffers[INDEX_BUFFER], grid.indices.size() * sizeof(uint32_t), grid.indices.data(), 0);
+        glNamedBufferStorage(buffers[INSTANCE_BUFFER], SLOT_COUNT * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        // Setup vertex attributes, the grid per vertex and the chunk per instance
+        glEnableVertexArrayAttrib(vertexArray, 0);
+        glVertexArrayAttribFormat(vertexArray, 0, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayVertexBuffer(vertexArray, 0, buffers[VERTEX_BUFFER], 0, sizeof(glm::vec4));
+        glVertexArrayAttribBinding(vertexArray, 0, 0);
+
+        glEnableVertexArrayAttrib(vertexArray, 1);
+        glVertexArrayAttribFormat(vertexArray, 1, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayVertexBuffer(vertexArray, 1, buffers[INSTANCE_BUFFER], 0, sizeof(glm::vec4));
+        glVertexArrayAttribBinding(vertexArray, 1, 1);
+        glVertexArrayBindingDivisor(vertexArray, 1, 1);
+
+        glVertexArrayElementBuffer(vertexArray, buffers[INDEX_BUFFER]);
+
+        // Setup uniform blocks
+        GLuint sceneInputDataIndex = glGetUniformBlockIndex(shader->program, "SceneInputData");
+        glUniformBlockBinding(shader->program, sceneInputDataIndex, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, scene.getSceneUniformBuffer());
+    }
+
+    ~ChunkedTerrain() override = default;
+
+    void update(float) override {
+    }
+
+    void render(const Scene& scene) override {
+        tiles.update();
+
+        const auto& header = tiles.getHeader();
+        chunks.clear();
+        select(scene.getCamera().getCameraPosition(), static_cast<int>(header.levelCount - 1), 0, 0);
+        glNamedBufferSubData(buffers[INSTANCE_BUFFER], 0, chunks.size() * sizeof(glm::vec4), chunks.data());
+
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+        glBindVertexArray(vertexArray);
+        glUseProgram(shader->program);
+        tiles.bind(0);
+        grassTexture->bind(1);
+        snowTexture->bind(2);
+        waterTexture->bind(3);
+        glUniform1f(glGetUniformLocation(shader->program, "waterHeight"), waterHeight);
+        glUniform1f(glGetUniformLocation(shader->program, "snowHeight"), snowHeight);
+        glUniform1f(glGetUniformLocation(shader->program, "heightScale"), header.heightScale);
+        glUniform1i(glGetUniformLocation(shader->program, "tileSize"), header.tileSize);
+        glUniform1f(glGetUniformLocation(shader->program, "skirtDepth"), SKIRT_DEPTH);
+        glUniform1f(glGetUniformLocation(shader->program, "textureScale"), TEXTURE_SCALE);
+        glDrawElementsInstanced(GL_PATCHES, indexCount, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(chunks.size()));
+    }
+
+private:
+    // The model's third buffer, holding each chunk as per instance vertex data rather than uniforms
+    static constexpr auto INSTANCE_BUFFER = UNIFORM_BUFFER;
+    static constexpr auto CHUNK_GRID_SIZE = 4;
+    // 129 x 129 16 bit tiles, about 17 MB whatever the size of the world
+    static constexpr auto SLOT_COUNT = 512;
+    static constexpr auto UPLOADS_PER_FRAME = 8;
+    static constexpr auto MAXIMUM_LOADING = 32;
+    static constexpr auto LOD_RANGE = 1.5f;
+    static constexpr auto SKIRT_DEPTH = 1.0f;
+    // As often as the single heightmap's textures repeat, once a patch
+    static constexpr auto TEXTURE_SCALE = 100.0f / 9;
+
+    TerrainTileCache tiles;
+    std::unique_ptr<Texture> waterTexture{};
+    std::unique_ptr<Texture> grassTexture{};
+    std::unique_ptr<Texture> snowTexture{};
+    float worldSize{};
+    int indexCount{};
+    // Origin in x and z, size and layer of every chunk drawn this frame
+    std::vector<glm::vec4> chunks{};
+
+    // Distance from the camera to the ground the tile covers, at any height it could have
+    float distanceTo(const glm::vec3& camera, const glm::vec2& origin, float size) const {
+        const glm::vec3 outside{
+                std::max(std::max(origin.x - camera.x, camera.x - (origin.x + size)), 0.0f),
+                std::max(std::max(-camera.y, camera.y - tiles.getHeader().heightScale), 0.0f),
+                std::max(std::max(origin.y - camera.z, camera.z - (origin.y + size)), 0.0f)
+        };
+        return glm::length(outside);
+    }
+
+    void select(const glm::vec3& camera, int level, int x, int y) {
+        const auto& header = tiles.getHeader();
+        const auto size = header.tileSize * header.sampleSpacing * (1 << level);
+        const glm::vec2 origin{x * size - worldSize / 2, y * size - worldSize / 2};
+
+        if (level > 0 && distanceTo(camera, origin, size) < LOD_RANGE * size) {
+            auto childrenResident = true;
+            for (auto i = 0; i < 4; i++) {
+                const TerrainTileKey child{level - 1, x * 2 + i % 2, y * 2 + i / 2};
+                if (tiles.find(child) < 0) {
+                    const auto childSize = size / 2;
+                    tiles.request(child, distanceTo(camera, origin + glm::vec2(i % 2, i / 2) * childSize, childSize));
+                    childrenResident = false;
+                }
+            }
+            if (childrenResident) {
+                for (auto i = 0; i < 4; i++) {
+                    select(camera, level - 1, x * 2 + i % 2, y * 2 + i / 2);
+                }
+                return;
+            }
+        }
+
+        chunks.emplace_back(origin.x, origin.y, size, tiles.find({level, x, y}));
+    }
 };
 
 void GLAPIENTRY debugCallback(GLenum source,
@@ -195,7 +457,7 @@ void keyboardCallback(unsigned char key, int, int) {
         wireframeMode = !wireframeMode;
     }
 
-    ((Terrain*)scene->getModel(0))->updateKeyboard(key);
+    ((TerrainModel*)scene->getModel(0))->updateKeyboard(key);
 
     keyState[key] = true;
 }
@@ -218,7 +480,11 @@ void specialUpCallback(int key, int, int) {
 
 void initialise() {
     scene = std::make_unique<Scene>();
-    scene->addModel(std::make_unique<Terrain>(*scene));
+    if (worldFile.empty()) {
+        scene->addModel(std::make_unique<Terrain>(*scene));
+    } else {
+        scene->addModel(std::make_unique<ChunkedTerrain>(*scene, worldFile));
+    }
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
@@ -226,13 +492,8 @@ void initialise() {
     glClearColor(1, 1, 1, 1);
 }
 
-void update(int) {
-    int timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
-    int deltaTime = timeSinceStart - oldTimeSinceStart;
-    oldTimeSinceStart = timeSinceStart;
-
-    float delta = deltaTime * 0.001f;
-
+// Advances the scene by delta seconds, moving the camera for any keys held down
+void step(float delta) {
     auto& camera = scene->getCamera();
 
     if (specialKeyState[GLUT_KEY_UP]) {
@@ -259,20 +520,53 @@ void update(int) {
     camera.lookAt(camera.getCameraPosition() - glm::vec3(0.0, 15.0, 20.0));
 
     scene->update(delta);
+}
+
+void update(int) {
+    int timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
+    int deltaTime = timeSinceStart - oldTimeSinceStart;
+    oldTimeSinceStart = timeSinceStart;
+
+    step(deltaTime * 0.001f);
     glutTimerFunc(50, update, 0);
     glutPostRedisplay();
 }
 
-void display() {
+void renderFrame() {
     glPolygonMode(GL_FRONT_AND_BACK, wireframeMode ? GL_LINE : GL_FILL);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     scene->render();
+}
+
+void display() {
+    renderFrame();
     glutSwapBuffers();
 }
 
 int main(int argc, char* argv[]) {
     ilInit();
+    // --world file streams a world cut by cosc422-cook, such as data/HeightMap1.tiles
+    for (auto i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--world" && i + 1 < argc) {
+            worldFile = argv[++i];
+        } else if (std::string(argv[i]) == "--flat") {
+            flatShading = true;
+        }
+    }
+    const auto headless = parseHeadlessOptions(argc, argv);
+    if (headless.enabled()) {
+        HeadlessContext context(800, 600, 4, 5, true);
+        initialise();
+        // Each frame steps as far as the window's 50 ms timer would
+        const auto succeeded = runHeadless(headless, context, [](int) {
+            step(0.05f);
+            renderFrame();
+        });
+        scene.reset();
+        return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     glutInit(&argc, argv);
     glutSetOption(GLUT_MULTISAMPLE, 8);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH | GLUT_MULTISAMPLE);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Flat grid of quad patches from -size to size in both x and z. Each vertex is x, z, then its heightmap coordinate.
+struct TerrainGrid {
+    std::vector<glm::vec4> vertices{};
+    // Four corners per patch, for GL_PATCHES with four vertices
+    std::vector<uint32_t> indices{};
+};
+
+inline TerrainGrid buildTerrainGrid(int gridSize, float size) {
+    TerrainGrid grid{};
+    grid.vertices.resize((gridSize + 1) * (gridSize + 1));
+    grid.indices.resize(gridSize * gridSize * 4);
+
+    for (auto y = 0; y < gridSize + 1; y++) {
+        for (auto x = 0; x < gridSize + 1; x++) {
+            grid.vertices[y * (gridSize + 1) + x] = glm::vec4{
+                    ((x * 2.0f) / gridSize - 1.0f) * size,
+                    ((y * 2.0f) / gridSize - 1.0f) * size,
+                    (float)x / gridSize,
+                    1 - (float)y / gridSize
+            };
+        }
+    }
+
+    for (auto y = 0; y < gridSize; y++) {
+        for (auto x = 0; x < gridSize; x++) {
+            grid.indices[(y * gridSize + x) * 4 + 0] = y * (gridSize + 1) + x;
+            grid.indices[(y * gridSize + x) * 4 + 1] = (y + 1) * (gridSize + 1) + x;
+            grid.indices[(y * gridSize + x) * 4 + 2] = (y + 1) * (gridSize + 1) + (x + 1);
+            grid.indices[(y * gridSize + x) * 4 + 3] = y * (gridSize + 1) + (x + 1);
+        }
+    }
+
+    return grid;
+}
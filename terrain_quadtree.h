@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <IL/il.h>
+#include <glm/glm.hpp>
+
+// Heights as the terrain shaders see them: the red channel of the heightmap, bottom row first, in world units
+struct HeightField {
+    int width{};
+    int height{};
+    std::vector<float> heights{};
+
+    float at(int x, int y) const {
+        return heights[std::min(std::max(y, 0), height - 1) * width + std::min(std::max(x, 0), width - 1)];
+    }
+};
+
+inline HeightField loadHeightField(const std::string& filePath, float scale) {
+    ILuint id = ilGenImage();
+    ilBindImage(id);
+    ilEnable(IL_ORIGIN_SET);
+    ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
+
+    if (!ilLoadImage(filePath.c_str())) {
+        ilDeleteImage(id);
+        std::cerr << "Unable to load height field: " + filePath << std::endl;
+        throw std::exception{};
+    }
+    // Converted as the texture is, so heights are quantised the same way
+    ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+
+    HeightField field{};
+    field.width = ilGetInteger(IL_IMAGE_WIDTH);
+    field.height = ilGetInteger(IL_IMAGE_HEIGHT);
+    field.heights.resize(field.width * field.height);
+    const auto data = ilGetData();
+    for (auto i = 0; i < field.width * field.height; i++) {
+        field.heights[i] = data[i * 4] / 255.0f * scale;
+    }
+
+    ilDeleteImage(id);
+    return field;
+}
+
+// Root mean square of the height lost by drawing each blockSize square of texels as one bilinear quad between its
+// corners, one texel per block: how much detail tessellating the block finer would add
+struct RoughnessMap {
+    int width{};
+    int height{};
+    int blockSize{};
+    std::vector<float> roughness{};
+
+    float at(int x, int y) const {
+        return roughness[std::min(std::max(y, 0), height - 1) * width + std::min(std::max(x, 0), width - 1)];
+    }
+};
+
+inline RoughnessMap buildRoughnessMap(const HeightField& field, int blockSize) {
+    RoughnessMap map{};
+    map.width = (field.width + blockSize - 1) / blockSize;
+    map.height = (field.height + blockSize - 1) / blockSize;
+    map.blockSize = blockSize;
+    map.roughness.resize(map.width * map.height);
+
+    for (auto blockY = 0; blockY < map.height; blockY++) {
+        for (auto blockX = 0; blockX < map.width; blockX++) {
+            const auto x0 = blockX * blockSize;
+            const auto y0 = blockY * blockSize;
+            const auto h00 = field.at(x0, y0);
+            const auto h10 = field.at(x0 + blockSize, y0);
+            const auto h01 = field.at(x0, y0 + blockSize);
+            const auto h11 = field.at(x0 + blockSize, y0 + blockSize);
+
+            auto sum = 0.0f;
+            for (auto y = 0; y <= blockSize; y++) {
+                for (auto x = 0; x <= blockSize; x++) {
+                    const auto u = (float)x / blockSize;
+                    const auto v = (float)y / blockSize;
+                    const auto plane = (h00 * (1 - u) + h10 * u) * (1 - v) + (h01 * (1 - u) + h11 * u) * v;
+                    const auto error = field.at(x0 + x, y0 + y) - plane;
+                    sum += error * error;
+                }
+            }
+            map.roughness[blockY * map.width + blockX] = std::sqrt(sum / ((blockSize + 1) * (blockSize + 1)));
+        }
+    }
+    return map;
+}
+
+// One level of a min/max pyramid over a heightmap, the lowest and highest height in each texel's footprint
+struct HeightBoundsLevel {
+    int width{};
+    int height{};
+    std::vector<glm::vec2> bounds{};
+};
+
+// Level 0 bounds each cell between four texel centres, everything a bilinear lookup inside it can return, and every
+// level above halves the size as OpenGL's mip chain does, rounding down. The last texel of an odd sized level takes in
+// the three children that leaves it, so a lookup still only has to read the two by two texels its range falls in.
+inline std::vector<HeightBoundsLevel> buildHeightBounds(const HeightField& field) {
+    std::vector<HeightBoundsLevel> levels(1);
+    auto& base = levels[0];
+    base.width = field.width;
+    base.height = field.height;
+    base.bounds.resize(base.width * base.height);
+    for (auto y = 0; y < base.height; y++) {
+        for (auto x = 0; x < base.width; x++) {
+            const auto h00 = field.at(x, y);
+            const auto h10 = field.at(x + 1, y);
+            const auto h01 = field.at(x, y + 1);
+            const auto h11 = field.at(x + 1, y + 1);
+            base.bounds[y * base.width + x] = glm::vec2{std::min(std::min(h00, h10), std::min(h01, h11)),
+                                                        std::max(std::max(h00, h10), std::max(h01, h11))};
+        }
+    }
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const auto& below = levels.back();
+        HeightBoundsLevel level{};
+        level.width = std::max(below.width / 2, 1);
+        level.height = std::max(below.height / 2, 1);
+        level.bounds.resize(level.width * level.height);
+        for (auto y = 0; y < level.height; y++) {
+            for (auto x = 0; x < level.width; x++) {
+                const auto lastX = x == level.width - 1 ? below.width - 1 : x * 2 + 1;
+                const auto lastY = y == level.height - 1 ? below.height - 1 : y * 2 + 1;
+                auto bounds = below.bounds[y * 2 * below.width + x * 2];
+                for (auto childY = y * 2; childY <= lastY; childY++) {
+                    for (auto childX = x * 2; childX <= lastX; childX++) {
+                        const auto& child = below.bounds[childY * below.width + childX];
+                        bounds = glm::vec2{std::min(bounds.x, child.x), std::max(bounds.y, child.y)};
+                    }
+                }
+                level.bounds[y * level.width + x] = bounds;
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+// How finely terrain.tesc tessellates an edge, which the quadtree has to agree with to merge patches without cracks
+struct TessellationDetail {
+    // Pixels a world unit covers one unit from the camera
+    float pixelScale;
+    // Target length of a triangle's edge on screen
+    float pixelsPerTriangle;
+    // Roughness at which an edge gets its full projected level, smoother ground scaled down to minimumDetail of it
+    float roughnessScale;
+    float minimumDetail;
+
+    // Before rounding up, so at most 1 means a single segment
+    float level(float edgeLength, float distance, float roughness) const {
+        const auto detail = std::min(std::max(roughness / roughnessScale, minimumDetail), 1.0f);
+        return edgeLength * pixelScale / std::max(distance, 1.0f) / pixelsPerTriangle * detail;
+    }
+};
+
+// Planes of a projection view matrix's clip volume, each facing inwards
+class Frustum {
+public:
+    explicit Frustum(const glm::mat4& projectionView) {
+        const auto row = [&projectionView](int i) {
+            return glm::vec4{projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]};
+        };
+        for (auto i = 0; i < 3; i++) {
+            planes[i * 2] = row(3) + row(i);
+            planes[i * 2 + 1] = row(3) - row(i);
+        }
+    }
+
+    // Conservative: boxes outside the volume but not wholly outside any one plane still intersect
+    bool intersects(const glm::vec3& min, const glm::vec3& max) const {
+        for (const auto& plane : planes) {
+            const glm::vec3 farthest{plane.x > 0 ? max.x : min.x, plane.y > 0 ? max.y : min.y, plane.z > 0 ? max.z : min.z};
+            if (plane.x * farthest.x + plane.y * farthest.y + plane.z * farthest.z + plane.w < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    glm::vec4 planes[6]{};
+};
+
+// Quadtree over the patches of a terrain grid as built by buildTerrainGrid, each node bounding the heights and
+// roughness of the patches beneath it. Selecting walks it to emit only the patches in view, and a node as one patch
+// rather than one per grid cell wherever every cell edge in it would get a single segment anyway.
+class TerrainQuadtree {
+public:
+    TerrainQuadtree(const HeightField& field, const RoughnessMap& roughness, int gridSize, float size)
+            : gridSize(gridSize), size(size) {
+        build(field, roughness, 0, 0, gridSize, gridSize);
+    }
+
+    // Appends the four corner indices of every patch to draw. Ground wholly below the water is left to the water's
+    // own quad, as terrain.tesc would discard it anyway.
+    void select(const Frustum& frustum, const glm::vec3& camera, const TessellationDetail& detail, float waterHeight,
+                std::vector<uint32_t>& indices) const {
+        select(0, frustum, camera, detail, waterHeight, indices);
+    }
+
+private:
+    struct Node {
+        // Grid cells covered, the upper bounds exclusive
+        int x0, y0, x1, y1;
+        float minimumHeight, maximumHeight;
+        float maximumRoughness;
+        int children[4];
+    };
+
+    int gridSize;
+    float size;
+    std::vector<Node> nodes{};
+
+    float gridToWorld(int coordinate) const {
+        return ((coordinate * 2.0f) / gridSize - 1.0f) * size;
+    }
+
+    uint32_t vertexIndex(int x, int y) const {
+        return y * (gridSize + 1) + x;
+    }
+
+    int build(const HeightField& field, const RoughnessMap& roughness, int x0, int y0, int x1, int y1) {
+        const auto index = static_cast<int>(nodes.size());
+        nodes.push_back({x0, y0, x1, y1, 0, 0, 0, {-1, -1, -1, -1}});
+
+        if (x1 - x0 == 1 && y1 - y0 == 1) {
+            // Every texel the patch's bilinear lookups can reach, the grid's v running top down
+            const auto texelX0 = static_cast<int>(std::floor((float)x0 / gridSize * field.width - 0.5f));
+            const auto texelX1 = static_cast<int>(std::ceil((float)x1 / gridSize * field.width - 0.5f));
+            const auto texelY0 = static_cast<int>(std::floor((1 - (float)y1 / gridSize) * field.height - 0.5f));
+            const auto texelY1 = static_cast<int>(std::ceil((1 - (float)y0 / gridSize) * field.height - 0.5f));
+            auto minimum = field.at(texelX0, texelY0);
+            auto maximum = minimum;
+            for (auto y = texelY0; y <= texelY1; y++) {
+                for (auto x = texelX0; x <= texelX1; x++) {
+                    minimum = std::min(minimum, field.at(x, y));
+                    maximum = std::max(maximum, field.at(x, y));
+                }
+            }
+            nodes[index].minimumHeight = minimum;
+            nodes[index].maximumHeight = maximum;
+
+            // Likewise every roughness texel a lookup at one of its edges' midpoints can reach
+            auto maximumRoughness = 0.0f;
+            for (auto y = texelY0 / roughness.blockSize - 1; y <= texelY1 / roughness.blockSize + 1; y++) {
+                for (auto x = texelX0 / roughness.blockSize - 1; x <= texelX1 / roughness.blockSize + 1; x++) {
+                    maximumRoughness = std::max(maximumRoughness, roughness.at(x, y));
+                }
+            }
+            nodes[index].maximumRoughness = maximumRoughness;
+            return index;
+        }
+
+        // Halve whichever sides are longer than a cell, so any grid size works
+        const auto splitX = x1 - x0 > 1 ? (x0 + x1) / 2 : x1;
+        const auto splitY = y1 - y0 > 1 ? (y0 + y1) / 2 : y1;
+        auto minimum = 0.0f;
+        auto maximum = 0.0f;
+        auto maximumRoughness = 0.0f;
+        auto child = 0;
+        for (const auto& range : {glm::ivec4{x0, y0, splitX, splitY}, glm::ivec4{splitX, y0, x1, splitY},
+                                  glm::ivec4{x0, splitY, splitX, y1}, glm::ivec4{splitX, splitY, x1, y1}}) {
+            if (range.x == range.z || range.y == range.w) {
+                continue;
+            }
+            const auto childIndex = build(field, roughness, range.x, range.y, range.z, range.w);
+            const auto& built = nodes[childIndex];
+            minimum = child == 0 ? built.minimumHeight : std::min(minimum, built.minimumHeight);
+            maximum = child == 0 ? built.maximumHeight : std::max(maximum, built.maximumHeight);
+            maximumRoughness = std::max(maximumRoughness, built.maximumRoughness);
+            nodes[index].children[child++] = childIndex;
+        }
+        nodes[index].minimumHeight = minimum;
+        nodes[index].maximumHeight = maximum;
+        nodes[index].maximumRoughness = maximumRoughness;
+        return index;
+    }
+
+    void select(int index, const Frustum& frustum, const glm::vec3& camera, const TessellationDetail& detail,
+                float waterHeight, std::vector<uint32_t>& indices) const {
+        const auto& node = nodes[index];
+        // Only what rises above the water can be seen
+        const glm::vec3 min{gridToWorld(node.x0), std::max(node.minimumHeight, waterHeight), gridToWorld(node.y0)};
+        const glm::vec3 max{gridToWorld(node.x1), node.maximumHeight, gridToWorld(node.y1)};
+        if (node.maximumHeight <= waterHeight || !frustum.intersects(min, max)) {
+            return;
+        }
+
+        // The longest a cell edge in the node can be, seen from as close as any of it is. The shader measures edges at
+        // their unclamped heights, so those bound them rather than the water.
+        const glm::vec3 outside{
+                std::max(std::max(min.x - camera.x, camera.x - max.x), 0.0f),
+                std::max(std::max(node.minimumHeight - camera.y, camera.y - node.maximumHeight), 0.0f),
+                std::max(std::max(min.z - camera.z, camera.z - max.z), 0.0f)
+        };
+        const auto cellSize = 2 * size / gridSize;
+        const auto rise = node.maximumHeight - node.minimumHeight;
+        const auto longestEdge = std::sqrt(cellSize * cellSize + rise * rise);
+        // With a margin, so rounding on the GPU cannot tip an edge over to two segments
+        const auto merge = detail.level(longestEdge, glm::length(outside), node.maximumRoughness) < 0.9f;
+        if (node.children[0] < 0 || merge) {
+            // Corners in the order the grid gives each patch
+            indices.push_back(vertexIndex(node.x0, node.y0));
+            indices.push_back(vertexIndex(node.x0, node.y1));
+            indices.push_back(vertexIndex(node.x1, node.y1));
+            indices.push_back(vertexIndex(node.x1, node.y0));
+            return;
+        }
+
+        for (auto child : node.children) {
+            if (child >= 0) {
+                select(child, frustum, camera, detail, waterHeight, indices);
+            }
+        }
+    }
+};
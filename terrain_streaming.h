@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "terrain_tiles.h"
+#include "thread_pool.h"
+
+struct TerrainTileKey {
+    int level;
+    int x;
+    int y;
+
+    uint64_t packed() const {
+        return static_cast<uint64_t>(level) << 48 | static_cast<uint64_t>(y) << 24 | static_cast<uint64_t>(x);
+    }
+};
+
+// Fixed number of tiles resident on the GPU as the layers of one texture array, whatever the size of the world.
+// Tiles are read and decoded on worker threads and uploaded at most a few per frame, so the frame a camera crosses
+// into new ground costs no more than any other; until a tile arrives the caller draws its coarser parent instead.
+// The least recently used tile is evicted for each arrival, but never one drawn last frame or from the top level,
+// which is loaded up front so there is always something to draw.
+class TerrainTileCache {
+public:
+    TerrainTileCache(const std::string& fileName, int slotCount, int uploadsPerFrame, int maximumLoading)
+            : file(fileName), slots(slotCount), uploadsPerFrame(uploadsPerFrame), maximumLoading(maximumLoading),
+              threadPool(2) {
+        const auto& header = file.getHeader();
+        samplesAcross = static_cast<int>(header.tileSize + 1);
+
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+        glTextureStorage3D(texture, 1, GL_R16, samplesAcross, samplesAcross, slotCount);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        const auto top = static_cast<int>(header.levelCount - 1);
+        upload({top, 0, 0}, file.readTile(top, 0, 0));
+        std::cout << "Streaming " << fileName << ": " << header.tilesAcross << " x " << header.tilesAcross << " tiles of "
+                  << header.tileSize << ", " << header.levelCount << " levels, " << slotCount << " resident" << std::endl;
+    }
+
+    TerrainTileCache(const TerrainTileCache&) = delete;
+    TerrainTileCache& operator=(const TerrainTileCache&) = delete;
+
+    ~TerrainTileCache() {
+        glDeleteTextures(1, &texture);
+    }
+
+    const TerrainTileHeader& getHeader() const {
+        return file.getHeader();
+    }
+
+    // Starts a frame: uploads tiles that finished loading since the last, then starts loading the closest of the
+    // tiles asked for last frame
+    void update() {
+        frame++;
+
+        std::deque<Loaded> arrived{};
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            const auto count = std::min<std::size_t>(loaded.size(), uploadsPerFrame);
+            arrived.insert(arrived.end(), std::make_move_iterator(loaded.begin()),
+                           std::make_move_iterator(loaded.begin() + count));
+            loaded.erase(loaded.begin(), loaded.begin() + count);
+        }
+        for (auto& tile : arrived) {
+            loading.erase(tile.key.packed());
+            if (tile.samples.empty()) {
+                failed.insert(tile.key.packed());
+            } else {
+                upload(tile.key, tile.samples);
+            }
+        }
+
+        std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+            return a.priority < b.priority;
+        });
+        for (const auto& request : requests) {
+            if (static_cast<int>(loading.size()) >= maximumLoading) {
+                break;
+            }
+            const auto packed = request.key.packed();
+            if (resident.count(packed) || failed.count(packed) || !loading.insert(packed).second) {
+                continue;
+            }
+            threadPool.submit([this, key = request.key] {
+                Loaded tile{key, {}};
+                try {
+                    tile.samples = file.readTile(key.level, key.x, key.y);
+                } catch (const std::exception&) {
+                    std::cerr << "Unable to read terrain tile " << key.level << " " << key.x << " " << key.y << std::endl;
+                }
+                std::lock_guard<std::mutex> lock{mutex};
+                loaded.push_back(std::move(tile));
+            });
+        }
+        requests.clear();
+    }
+
+    // Layer holding the tile, marked as drawn this frame, or -1 if it is not resident
+    int find(const TerrainTileKey& key) {
+        const auto found = resident.find(key.packed());
+        if (found == resident.end()) {
+            return -1;
+        }
+        slots[found->second].lastUsed = frame;
+        return found->second;
+    }
+
+    // Asks for the tile to be loaded, the lowest priorities first. Tiles that could not be read are never asked for
+    // again, their parents drawn in their place.
+    void request(const TerrainTileKey& key, float priority) {
+        if (!resident.count(key.packed()) && !failed.count(key.packed())) {
+            requests.push_back({key, priority});
+        }
+    }
+
+    void bind(int unit) const {
+        glBindTextureUnit(unit, texture);
+    }
+
+private:
+    struct Slot {
+        TerrainTileKey key;
+        bool occupied;
+        uint64_t lastUsed;
+    };
+
+    struct Request {
+        TerrainTileKey key;
+        float priority;
+    };
+
+    // Empty samples for a tile that could not be read
+    struct Loaded {
+        TerrainTileKey key;
+        std::vector<uint16_t> samples;
+    };
+
+    TerrainTileFile file;
+    std::vector<Slot> slots;
+    int uploadsPerFrame;
+    int maximumLoading;
+    int samplesAcross{};
+    GLuint texture{};
+    uint64_t frame{1};
+
+    std::unordered_map<uint64_t, int> resident{};
+    std::unordered_set<uint64_t> loading{};
+    std::unordered_set<uint64_t> failed{};
+    std::vector<Request> requests{};
+
+    std::mutex mutex{};
+    std::deque<Loaded> loaded{};
+    // Last, so its workers are joined before anything they use is destroyed
+    ThreadPool threadPool;
+
+    void upload(const TerrainTileKey& key, const std::vector<uint16_t>& samples) {
+        const auto top = static_cast<int>(getHeader().levelCount - 1);
+        auto victim = -1;
+        for (auto i = 0; i < static_cast<int>(slots.size()); i++) {
+            const auto& slot = slots[i];
+            if (!slot.occupied) {
+                victim = i;
+                break;
+            }
+            if (slot.lastUsed + 1 < frame && slot.key.level != top && (victim < 0 || slot.lastUsed < slots[victim].lastUsed)) {
+                victim = i;
+            }
+        }
+        // Every slot was drawn last frame, the tile is asked for again next frame
+        if (victim < 0) {
+            return;
+        }
+
+        auto& slot = slots[victim];
+        if (slot.occupied) {
+            resident.erase(slot.key.packed());
+        }
+        slot = {key, true, frame};
+        resident[key.packed()] = victim;
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTextureSubImage3D(texture, 0, 0, 0, victim, samplesAcross, samplesAcross, 1, GL_RED, GL_UNSIGNED_SHORT,
+                            samples.data());
+    }
+};
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+
+// Tiled terrain world, cut from a heightmap by the cooker and paged in by the terrain viewer's chunked mode.
+//
+// Level 0 holds the full resolution heights as tilesAcross x tilesAcross tiles of tileSize x tileSize cells. Each level
+// above halves the tiles across and doubles the ground each covers, down to a single tile, so a tile at any level is
+// the same size in memory. Tiles store their tileSize + 1 edge samples, shared with their neighbours, and each level
+// keeps every other sample of the one below rather than averaging, so tiles of any two levels agree where their
+// samples coincide.
+//
+// Tiles are compressed independently: every sample is predicted from its left, upper and upper left neighbours, and
+// the residuals written as zigzag varints, so smooth ground costs about a byte a sample instead of two.
+
+// Bump whenever the layout or encoding below changes, so old files are recut
+const uint32_t terrainTilesVersion = 1;
+const char terrainTilesMagic[8] = {'C', 'O', 'S', 'C', 'T', 'I', 'L', 'E'};
+
+struct TerrainTileEntry {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t _padding;
+};
+
+struct TerrainTileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tileSize;
+    uint32_t tilesAcross;
+    uint32_t levelCount;
+    // World units between level 0 samples, and the height of the largest sample
+    float sampleSpacing;
+    float heightScale;
+    // Size and modification time of the heightmap the world was cut from
+    int64_t sourceSize;
+    int64_t sourceModified;
+    // Every level's tiles, row by row from level 0 up
+    uint64_t entries;
+};
+
+inline uint32_t terrainTilesAt(const TerrainTileHeader& header, int level) {
+    return header.tilesAcross >> level;
+}
+
+inline std::size_t terrainTileIndex(const TerrainTileHeader& header, int level, int x, int y) {
+    std::size_t index = 0;
+    for (auto i = 0; i < level; i++) {
+        index += terrainTilesAt(header, i) * terrainTilesAt(header, i);
+    }
+    return index + y * terrainTilesAt(header, level) + x;
+}
+
+inline void appendVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+// Throws if the bytes run out first
+inline uint32_t readVarint(const uint8_t* bytes, std::size_t length, std::size_t& position) {
+    uint32_t value = 0;
+    for (auto shift = 0;; shift += 7) {
+        if (position >= length || shift > 28) {
+            throw std::exception{};
+        }
+        const auto byte = bytes[position++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+inline int predictTerrainSample(const int32_t* values, int size, int x, int y) {
+    const auto left = x > 0 ? values[y * size + x - 1] : y > 0 ? values[(y - 1) * size + x] : 0;
+    const auto up = y > 0 ? values[(y - 1) * size + x] : left;
+    const auto upLeft = x > 0 && y > 0 ? values[(y - 1) * size + x - 1] : up;
+    return left + up - upLeft;
+}
+
+// Samples of the given size square, row by row. They are stored as steps above the tile's lowest sample, the step
+// being the largest that divides them all, so 8 bit heights widened to 16 cost no more than they did before.
+inline std::vector<uint8_t> encodeTerrainTile(const uint16_t* samples, int size) {
+    const auto count = size * size;
+    uint32_t minimum = 0xFFFF;
+    for (auto i = 0; i < count; i++) {
+        minimum = std::min<uint32_t>(minimum, samples[i]);
+    }
+    uint32_t step = 0;
+    for (auto i = 0; i < count && step != 1; i++) {
+        for (uint32_t value = samples[i] - minimum; value != 0;) {
+            const auto remainder = step % value;
+            step = value;
+            value = remainder;
+        }
+    }
+    step = std::max(step, 1u);
+
+    std::vector<int32_t> values(count);
+    for (auto i = 0; i < count; i++) {
+        values[i] = static_cast<int32_t>((samples[i] - minimum) / step);
+    }
+
+    std::vector<uint8_t> bytes{};
+    bytes.reserve(count + 8);
+    appendVarint(bytes, minimum);
+    appendVarint(bytes, step);
+    for (auto y = 0; y < size; y++) {
+        for (auto x = 0; x < size; x++) {
+            const auto residual = values[y * size + x] - predictTerrainSample(values.data(), size, x, y);
+            appendVarint(bytes, (static_cast<uint32_t>(residual) << 1) ^ static_cast<uint32_t>(residual >> 31));
+        }
+    }
+    return bytes;
+}
+
+// Throws if the bytes run out or hold more than a tile
+inline void decodeTerrainTile(const uint8_t* bytes, std::size_t length, uint16_t* samples, int size) {
+    std::size_t position = 0;
+    const auto minimum = readVarint(bytes, length, position);
+    const auto step = readVarint(bytes, length, position);
+
+    std::vector<int32_t> values(size * size);
+    for (auto y = 0; y < size; y++) {
+        for (auto x = 0; x < size; x++) {
+            const auto zigzag = readVarint(bytes, length, position);
+            const auto residual = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+            const auto value = predictTerrainSample(values.data(), size, x, y) + residual;
+            values[y * size + x] = value;
+            samples[y * size + x] = static_cast<uint16_t>(minimum + value * step);
+        }
+    }
+    if (position != length) {
+        throw std::exception{};
+    }
+}
+
+// Cuts a world of tilesAcross tiles, a power of two, from sample(x, y), which is called with level 0 sample
+// coordinates from 0 to tilesAcross * tileSize inclusive. Tiles are encoded on the pool a level at a time.
+inline void writeTerrainTiles(const std::string& fileName, const std::function<uint16_t(int x, int y)>& sample,
+                              uint32_t tileSize, uint32_t tilesAcross, float sampleSpacing, float heightScale,
+                              int64_t sourceSize, int64_t sourceModified, ThreadPool& threadPool) {
+    if (tilesAcross == 0 || (tilesAcross & (tilesAcross - 1)) != 0) {
+        throw std::exception{};
+    }
+
+    TerrainTileHeader header{};
+    std::memcpy(header.magic, terrainTilesMagic, sizeof(header.magic));
+    header.version = terrainTilesVersion;
+    header.tileSize = tileSize;
+    header.tilesAcross = tilesAcross;
+    while ((tilesAcross >> header.levelCount) > 0) {
+        header.levelCount++;
+    }
+    header.sampleSpacing = sampleSpacing;
+    header.heightScale = heightScale;
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    header.entries = sizeof(TerrainTileHeader);
+
+    // Written beside the target and renamed over it, so an interrupted cook never leaves a partial file behind
+    std::vector<TerrainTileEntry> entries(terrainTileIndex(header, header.levelCount, 0, 0));
+    const auto temporaryName = fileName + ".tmp";
+    std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TerrainTileEntry));
+    auto offset = static_cast<uint64_t>(header.entries + entries.size() * sizeof(TerrainTileEntry));
+
+    const auto samplesAcross = static_cast<int>(tileSize + 1);
+    for (auto level = 0; level < static_cast<int>(header.levelCount); level++) {
+        const auto across = static_cast<int>(terrainTilesAt(header, level));
+        std::vector<std::vector<uint8_t>> tiles(across * across);
+        threadPool.parallelFor(across * across, [&](int index) {
+            const auto tileX = index % across;
+            const auto tileY = index / across;
+            std::vector<uint16_t> samples(samplesAcross * samplesAcross);
+            for (auto y = 0; y < samplesAcross; y++) {
+                for (auto x = 0; x < samplesAcross; x++) {
+                    samples[y * samplesAcross + x] = sample((tileX * tileSize + x) << level, (tileY * tileSize + y) << level);
+                }
+            }
+            tiles[index] = encodeTerrainTile(samples.data(), samplesAcross);
+        });
+
+        for (auto index = 0; index < across * across; index++) {
+            auto& entry = entries[terrainTileIndex(header, level, index % across, index / across)];
+            entry.offset = offset;
+            entry.size = static_cast<uint32_t>(tiles[index].size());
+            file.write(reinterpret_cast<const char*>(tiles[index].data()), tiles[index].size());
+            offset += tiles[index].size();
+        }
+    }
+
+    file.seekp(static_cast<std::streamoff>(header.entries));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TerrainTileEntry));
+    file.close();
+    if (!file || std::rename(temporaryName.c_str(), fileName.c_str()) != 0) {
+        std::remove(temporaryName.c_str());
+        throw std::exception{};
+    }
+}
+
+// Open tile file, safe to read tiles from on any number of threads at once
+class TerrainTileFile {
+public:
+    explicit TerrainTileFile(const std::string& fileName) {
+        descriptor = open(fileName.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::exception{};
+        }
+
+        try {
+            read(&header, sizeof(header), 0);
+            if (std::memcmp(header.magic, terrainTilesMagic, sizeof(header.magic)) != 0 ||
+                header.version != terrainTilesVersion || header.tileSize == 0 || header.levelCount == 0 ||
+                terrainTilesAt(header, header.levelCount - 1) != 1) {
+                throw std::exception{};
+            }
+            entries.resize(terrainTileIndex(header, header.levelCount, 0, 0));
+            read(entries.data(), entries.size() * sizeof(TerrainTileEntry), header.entries);
+        } catch (const std::exception&) {
+            close(descriptor);
+            throw;
+        }
+    }
+
+    TerrainTileFile(const TerrainTileFile&) = delete;
+    TerrainTileFile& operator=(const TerrainTileFile&) = delete;
+
+    ~TerrainTileFile() {
+        close(descriptor);
+    }
+
+    const TerrainTileHeader& getHeader() const {
+        return header;
+    }
+
+    // The tile's (tileSize + 1) squared samples, row by row
+    std::vector<uint16_t> readTile(int level, int x, int y) const {
+        const auto& entry = entries[terrainTileIndex(header, level, x, y)];
+        std::vector<uint8_t> bytes(entry.size);
+        read(bytes.data(), bytes.size(), entry.offset);
+
+        const auto samplesAcross = static_cast<int>(header.tileSize + 1);
+        std::vector<uint16_t> samples(samplesAcross * samplesAcross);
+        decodeTerrainTile(bytes.data(), bytes.size(), samples.data(), samplesAcross);
+        return samples;
+    }
+
+private:
+    int descriptor{-1};
+    TerrainTileHeader header{};
+    std::vector<TerrainTileEntry> entries{};
+
+    void read(void* data, std::size_t length, uint64_t offset) const {
+        auto bytes = static_cast<char*>(data);
+        while (length > 0) {
+            const auto count = pread(descriptor, bytes, length, static_cast<off_t>(offset));
+            if (count <= 0) {
+                throw std::exception{};
+            }
+            bytes += count;
+            length -= count;
+            offset += count;
+        }
+    }
+};
@@ -33,6 +33,37 @@ public:
         ilDeleteImage(id);
     }
 
+    // Texels generated by the program rather than loaded, sampled linearly and clamped at the edges
+    Texture(int width, int height, GLenum internalFormat, GLenum format, GLenum type, const void* data) {
+        glCreateSamplers(1, &sampler);
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glTextureStorage2D(texture, 1, internalFormat, width, height);
+        glTextureSubImage2D(texture, 0, 0, 0, width, height, format, type, data);
+    }
+
+    // Storage for the given number of mip levels, each filled in with upload and point sampled between them
+    Texture(int width, int height, int levels, GLenum internalFormat) {
+        glCreateSamplers(1, &sampler);
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glTextureStorage2D(texture, levels, internalFormat, width, height);
+    }
+
+    void upload(int level, int width, int height, GLenum format, GLenum type, const void* data) {
+        glTextureSubImage2D(texture, level, 0, 0, width, height, format, type, data);
+    }
+
     ~Texture() {
         glDeleteTextures(1, &texture);
         glDeleteSamplers(1, &sampler);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs in the order they were submitted
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+        for (auto i = 0u; i < threadCount; i++) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // Calls task(i) for every i in [0, count) on the workers and the calling thread, returning once all calls have
+    // finished. Each index runs exactly once, so tasks writing only their own outputs give the same result as a loop.
+    void parallelFor(int count, const std::function<void(int)>& task) {
+        if (count <= 0) {
+            return;
+        }
+
+        struct Batch {
+            std::atomic<int> next{};
+            std::atomic<int> remaining{};
+            std::mutex mutex{};
+            std::condition_variable done{};
+        };
+
+        auto batch = std::make_shared<Batch>();
+        batch->remaining = count;
+
+        // Helpers that start after the batch has finished find no work left, so the batch is shared rather than
+        // owned by this frame
+        auto drain = [batch, count, &task] {
+            for (auto i = batch->next++; i < count; i = batch->next++) {
+                task(i);
+                if (--batch->remaining == 0) {
+                    std::lock_guard<std::mutex> lock{batch->mutex};
+                    batch->done.notify_all();
+                }
+            }
+        };
+
+        const auto helpers = std::min<int>(count - 1, static_cast<int>(workers.size()));
+        for (auto i = 0; i < helpers; i++) {
+            submit(drain);
+        }
+        drain();
+
+        std::unique_lock<std::mutex> lock{batch->mutex};
+        batch->done.wait(lock, [&batch] { return batch->remaining == 0; });
+    }
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> job{};
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers{};
+    std::deque<std::function<void()>> jobs{};
+    std::mutex mutex{};
+    std::condition_variable wake{};
+    bool stopping{};
+};